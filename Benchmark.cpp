@@ -0,0 +1,230 @@
+#include "Configuration.h"
+#include "GameEvent.h"
+#include "GameGenerator.h"
+#include "Replay.h"
+#include "Solver.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <streambuf>
+
+using json = nlohmann::json;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int const DEFAULT_GAMES = 100;  // Games generated for each configuration and rule set
+int const DEFAULT_TURNS = 80;   // Most turns in a game
+int const MIN_PLAYERS   = 3;
+int const MAX_PLAYERS   = 6;
+
+char const * const DEFAULT_CONFIGURATIONS[] =
+{
+    "classic.txt",
+    "master_detective.txt",
+    "haunted_mansion.txt",
+    "star_wars.txt"
+};
+
+char const * const RULES[]       = { "classic", "master" };
+char const * const EVENT_KINDS[] = { "hand", "show", "suggest", "accuse", "undo" };   // By GameEvent::Kind
+
+// Discards everything written to it, so that formatting is measured but not writing
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Collects measurements (in microseconds) and summarizes them
+class Samples
+{
+public:
+    void add(double us) { samples_.push_back(us); }
+    void add(Clock::time_point start, Clock::time_point end)
+    {
+        add(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    json summary()
+    {
+        json j = { { "count", samples_.size() } };
+        if (samples_.empty())
+            return j;
+        std::sort(samples_.begin(), samples_.end());
+        j["mean"] = std::accumulate(samples_.begin(), samples_.end(), 0.0) / samples_.size();
+        j["p50"]  = percentile(50.0);
+        j["p90"]  = percentile(90.0);
+        j["p99"]  = percentile(99.0);
+        j["max"]  = samples_.back();
+        return j;
+    }
+
+private:
+    // Returns the nearest-rank percentile. The samples must be sorted.
+    double percentile(double p) const
+    {
+        size_t rank = (size_t)std::ceil(p / 100.0 * samples_.size());
+        return samples_[std::max<size_t>(rank, 1) - 1];
+    }
+
+    std::vector<double> samples_;
+};
+
+// Applies the events of a game to a new solver, measuring each event and the whole game
+void play(Configuration const & configuration, Game const & game, std::map<std::string, Samples> & latencies)
+{
+    auto gameStart = Clock::now();
+
+    Solver       solver(configuration.solverRules(), game.players);
+    EventApplier applier(solver);
+    for (auto const & e : game.events)
+    {
+        auto start = Clock::now();
+        applier.apply(e);
+        latencies[EVENT_KINDS[e.kind]].add(start, Clock::now());
+    }
+    latencies["game"].add(gameStart, Clock::now());
+}
+
+void print(std::ostream & out, std::string const & name, json const & summary)
+{
+    out << "  " << std::left << std::setw(8) << name << std::right << std::setw(8) << summary["count"].get<size_t>();
+    if (summary.find("mean") != summary.end())
+    {
+        out << std::fixed << std::setprecision(1);
+        for (auto const * key : { "mean", "p50", "p90", "p99", "max" })
+        {
+            out << std::setw(11) << summary[key].get<double>();
+        }
+        out << std::defaultfloat;
+    }
+    out << std::endl;
+}
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::string> configurationFileNames;
+    char *                   reportFileName = nullptr;
+    int                      games          = DEFAULT_GAMES;
+    int                      turns          = DEFAULT_TURNS;
+    uint64_t                 seed           = 1;
+
+    while (--argc > 0)
+    {
+        ++argv;
+        if (**argv == '-')
+        {
+            switch ((*argv)[1])
+            {
+                case 'c':
+                    if (--argc > 0)
+                        configurationFileNames.push_back(*++argv);
+                    break;
+                case 'g':
+                    if (--argc > 0)
+                        games = atoi(*++argv);
+                    break;
+                case 'o':
+                    if (--argc > 0)
+                        reportFileName = *++argv;
+                    break;
+                case 's':
+                    if (--argc > 0)
+                        seed = strtoull(*++argv, nullptr, 10);
+                    break;
+                case 't':
+                    if (--argc > 0)
+                        turns = atoi(*++argv);
+                    break;
+            }
+        }
+    }
+
+    if (configurationFileNames.empty())
+    {
+        for (auto const * name : DEFAULT_CONFIGURATIONS)
+        {
+            configurationFileNames.push_back(std::string(CONFIGURATION_DIRECTORY) + "/" + name);
+        }
+    }
+
+    json report = { { "seed", seed }, { "games", games }, { "turns", turns }, { "units", "us" }, { "results", json::array() } };
+
+    for (auto const & name : configurationFileNames)
+    {
+        Configuration configuration;
+        if (!configuration.load(name.c_str()))
+        {
+            std::cerr << "Cannot load the configuration from '" << name << "'" << std::endl;
+            return 1;
+        }
+
+        for (auto const * rules : RULES)
+        {
+            configuration.rules = rules;
+            GameGenerator                  generator(configuration, seed);
+            std::map<std::string, Samples> latencies;
+            Samples                        replays;
+            NullBuffer                     nullBuffer;
+            std::ostream                   null(&nullBuffer);
+            size_t                         events = 0;
+
+            for (int i = 0; i < games; ++i)
+            {
+                Game game = generator.generate(MIN_PLAYERS + i % (MAX_PLAYERS - MIN_PLAYERS + 1), turns);
+                events += game.events.size();
+                play(configuration, game, latencies);
+
+                // Replay the game as ClueSolver would, including parsing the input and formatting the output
+                std::ostringstream log;
+                game.write(log);
+                std::istringstream in(log.str());
+                auto               start = Clock::now();
+                replay(configuration, in, null, null);
+                replays.add(start, Clock::now());
+            }
+
+            json result = { { "configuration", name }, { "rules", rules }, { "events", events } };
+            for (auto & l : latencies)
+            {
+                result["latency"][l.first] = l.second.summary();
+            }
+            result["replay"] = replays.summary();
+
+            std::cout << name << " (" << rules << " rules), " << games << " games, " << events << " events" << std::endl;
+            std::cout << "  event      count    mean us     p50 us     p90 us     p99 us     max us" << std::endl;
+            for (auto const * kind : { "hand", "show", "suggest", "accuse", "game" })
+            {
+                if (result["latency"].find(kind) != result["latency"].end())
+                    print(std::cout, kind, result["latency"][kind]);
+            }
+            print(std::cout, "replay", result["replay"]);
+            report["results"].push_back(result);
+        }
+    }
+
+    if (reportFileName)
+    {
+        std::ofstream file(reportFileName);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open '" << reportFileName << "' for writing." << std::endl;
+            return 3;
+        }
+        file << report.dump(4) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#if !defined(BITS_H)
+#define BITS_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//! Returns the number of bits set in the mask
+inline int countBits(uint64_t m)
+{
+#if defined(_MSC_VER)
+    return (int)__popcnt64(m);
+#else
+    return __builtin_popcountll(m);
+#endif
+}
+
+//! Returns the index of the lowest set bit. The mask must not be 0.
+inline int lowestBit(uint64_t m)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, m);
+    return (int)i;
+#else
+    return __builtin_ctzll(m);
+#endif
+}
+
+//! Returns the index of the highest set bit. The mask must not be 0.
+inline int highestBit(uint64_t m)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanReverse64(&i, m);
+    return (int)i;
+#else
+    return 63 - __builtin_clzll(m);
+#endif
+}
+
+//! Returns a mask with only the specified bit set
+inline uint64_t bit(int i)
+{
+    return uint64_t(1) << i;
+}
+
+//! Calls f(i) for each bit i set in the mask, in increasing order
+template <typename F>
+void forEachBit(uint64_t m, F f)
+{
+    while (m)
+    {
+        f(lowestBit(m));
+        m &= m - 1;
+    }
+}
+
+//! Sets bit i in a bit vector, growing it if necessary
+inline void setBit(std::vector<uint64_t> & v, int i)
+{
+    if ((size_t)(i / 64) >= v.size())
+        v.resize(i / 64 + 1, 0);
+    v[i / 64] |= bit(i % 64);
+}
+
+//! Clears bit i in a bit vector
+inline void clearBit(std::vector<uint64_t> & v, int i)
+{
+    if ((size_t)(i / 64) < v.size())
+        v[i / 64] &= ~bit(i % 64);
+}
+
+//! Returns the index of the first bit set at or after i in a bit vector, or -1 if there are none
+inline int nextBit(std::vector<uint64_t> const & v, int i)
+{
+    size_t w = i / 64;
+    if (w >= v.size())
+        return -1;
+    uint64_t m = v[w] & (~uint64_t(0) << (i % 64));
+    while (m == 0)
+    {
+        if (++w >= v.size())
+            return -1;
+        m = v[w];
+    }
+    return (int)w * 64 + lowestBit(m);
+}
+
+#endif // !defined(BITS_H)
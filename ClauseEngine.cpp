@@ -0,0 +1,655 @@
+#include "ClauseEngine.h"
+
+#include "Bits.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+int const TRUE_LITERAL  = -1;   // Constants that clauses may be given, which are simplified away
+int const FALSE_LITERAL = -2;
+
+int const    INITIAL_LEARNED_LIMIT = 2000;
+int const    FIRST_RESTART         = 100;       // Conflicts before the first restart of a search
+double const VARIABLE_DECAY        = 0.95;
+double const CLAUSE_DECAY          = 0.999;
+double const RESCALE_LIMIT         = 1e100;
+
+inline int positive(int variable)
+{
+    return 2 * variable;
+}
+
+inline int negative(int variable)
+{
+    return 2 * variable + 1;
+}
+
+inline int negate(int literal)
+{
+    if (literal < 0)
+        return (literal == TRUE_LITERAL) ? FALSE_LITERAL : TRUE_LITERAL;
+    return literal ^ 1;
+}
+
+inline int variableOf(int literal)
+{
+    return literal >> 1;
+}
+} // anonymous namespace
+
+ClauseEngine::ClauseEngine(Constraints const & constraints)
+    : players_(constraints.playerCount())
+    , answer_(constraints.answer)
+    , possible_(constraints.possible)
+    , minCards_(constraints.minCards)
+    , maxCards_(constraints.maxCards)
+    , contradiction_(false)
+    , learnedCount_(0)
+    , learnedLimit_(INITIAL_LEARNED_LIMIT)
+    , variableIncrement_(1.0)
+    , clauseIncrement_(1.0)
+    , head_(0)
+{
+    uint64_t allCards = 0;
+    for (auto t : constraints.types)
+    {
+        allCards |= t;
+    }
+    cards_ = allCards ? highestBit(allCards) + 1 : 0;
+    for (int i = 0; i < players_ * cards_; ++i)
+    {
+        newVariable();
+    }
+
+    // Every card is held by exactly one player
+    for (int c = 0; c < cards_; ++c)
+    {
+        std::vector<Literal> holders;
+        for (int p = 0; p < players_; ++p)
+        {
+            holders.push_back(positive(cell(p, c)));
+            for (int q = p + 1; q < players_; ++q)
+            {
+                addClause({ negative(cell(p, c)), negative(cell(q, c)) });
+            }
+        }
+        addClause(holders);
+    }
+
+    // The answer holds exactly one card of each type
+    for (auto t : constraints.types)
+    {
+        std::vector<Literal> cards;
+        forEachBit(t, [&] (int c) {
+            cards.push_back(positive(cell(answer_, c)));
+            forEachBit(t & ~(bit(c) | (bit(c) - 1)), [&] (int d) {
+                addClause({ negative(cell(answer_, c)), negative(cell(answer_, d)) });
+            });
+        });
+        addClause(cards);
+    }
+
+    // The other players hold numbers of cards within their limits
+    for (int p = 0; p < players_; ++p)
+    {
+        if (p != answer_)
+            addCounter(p, minCards_[p], maxCards_[p]);
+    }
+
+    for (int p = 0; p < players_; ++p)
+    {
+        for (int c = 0; c < cards_; ++c)
+        {
+            if (!(possible_[p] & bit(c)))
+                addClause({ negative(cell(p, c)) });
+        }
+    }
+
+    update(constraints);
+}
+
+bool ClauseEngine::update(Constraints const & constraints)
+{
+    if (constraints.playerCount() != players_ ||
+        constraints.answer != answer_ ||
+        constraints.minCards != minCards_ ||
+        constraints.maxCards != maxCards_ ||
+        constraints.holdsOneOf.size() < holdsOneOf_.size() ||
+        constraints.answerNotAll.size() < answerNotAll_.size())
+    {
+        return false;
+    }
+    for (int p = 0; p < players_; ++p)
+    {
+        if (constraints.possible[p] & ~possible_[p])
+            return false;
+    }
+    for (size_t i = 0; i < holdsOneOf_.size(); ++i)
+    {
+        if (constraints.holdsOneOf[i].player != holdsOneOf_[i].player ||
+            constraints.holdsOneOf[i].cards != holdsOneOf_[i].cards)
+        {
+            return false;
+        }
+    }
+    if (!std::equal(answerNotAll_.begin(), answerNotAll_.end(), constraints.answerNotAll.begin()))
+        return false;
+
+    backtrack(0);
+    for (int p = 0; p < players_; ++p)
+    {
+        forEachBit(possible_[p] & ~constraints.possible[p], [&] (int c) {
+            addClause({ negative(cell(p, c)) });
+        });
+        possible_[p] = constraints.possible[p];
+    }
+    for (size_t i = holdsOneOf_.size(); i < constraints.holdsOneOf.size(); ++i)
+    {
+        Constraints::HoldsOneOf const & h = constraints.holdsOneOf[i];
+        std::vector<Literal>            cards;
+        forEachBit(h.cards, [&] (int c) { cards.push_back(positive(cell(h.player, c))); });
+        addClause(cards);
+        holdsOneOf_.push_back(h);
+    }
+    for (size_t i = answerNotAll_.size(); i < constraints.answerNotAll.size(); ++i)
+    {
+        std::vector<Literal> cards;
+        forEachBit(constraints.answerNotAll[i], [&] (int c) { cards.push_back(negative(cell(answer_, c))); });
+        addClause(cards);
+        answerNotAll_.push_back(constraints.answerNotAll[i]);
+    }
+    return true;
+}
+
+std::vector<uint64_t> ClauseEngine::excluded()
+{
+    std::vector<uint64_t> excluded(players_, 0);
+    std::vector<uint64_t> witnessed(players_, 0);   // Cells assigned by a consistent deal that has been found
+
+    auto record = [&] () {
+        for (int p = 0; p < players_; ++p)
+        {
+            for (int c = 0; c < cards_; ++c)
+            {
+                if (values_[cell(p, c)] > 0)
+                    witnessed[p] |= bit(c);
+            }
+        }
+        backtrack(0);
+    };
+
+    if (learnedCount_ > learnedLimit_)
+        reduce();
+
+    if (!solve({}))
+    {
+        backtrack(0);
+        return excluded;
+    }
+    record();
+
+    for (int p = 0; p < players_; ++p)
+    {
+        for (int c = 0; c < cards_; ++c)
+        {
+            if (!(possible_[p] & bit(c)) || (witnessed[p] & bit(c)))
+                continue;
+            Literal holds = positive(cell(p, c));
+            if (value(holds) < 0)
+            {
+                excluded[p] |= bit(c);
+            }
+            else if (solve({ holds }))
+            {
+                record();
+            }
+            else
+            {
+                backtrack(0);
+                excluded[p] |= bit(c);
+                addClause({ negate(holds) });
+            }
+        }
+    }
+    return excluded;
+}
+
+bool ClauseEngine::allows(int player, uint64_t cards, uint64_t & held)
+{
+    if (learnedCount_ > learnedLimit_)
+        reduce();
+
+    std::vector<Literal> assumptions;
+    forEachBit(cards, [&] (int c) { assumptions.push_back(positive(cell(player, c))); });
+    bool found = solve(assumptions);
+    if (found)
+    {
+        held = 0;
+        for (int c = 0; c < cards_; ++c)
+        {
+            if (values_[cell(player, c)] > 0)
+                held |= bit(c);
+        }
+    }
+    backtrack(0);
+    return found;
+}
+
+// Adds a clause at decision level 0, simplifying it with what is already known there
+void ClauseEngine::addClause(std::vector<Literal> literals)
+{
+    assert(level() == 0);
+    if (contradiction_)
+        return;
+
+    std::sort(literals.begin(), literals.end());
+    literals.erase(std::unique(literals.begin(), literals.end()), literals.end());
+    size_t n = 0;
+    for (size_t i = 0; i < literals.size(); ++i)
+    {
+        Literal l = literals[i];
+        if (l == TRUE_LITERAL || (l >= 0 && value(l) > 0))
+            return;
+        if (l >= 0 && i + 1 < literals.size() && literals[i + 1] == negate(l))
+            return;
+        if (l >= 0 && value(l) == 0)
+            literals[n++] = l;
+    }
+    literals.resize(n);
+
+    if (literals.empty())
+    {
+        contradiction_ = true;
+    }
+    else if (literals.size() == 1)
+    {
+        assign(literals[0], -1);
+        if (propagate() >= 0)
+            contradiction_ = true;
+    }
+    else
+    {
+        attach(literals, false);
+    }
+}
+
+// Stores a clause and watches its first two literals. Returns the index of the clause.
+int ClauseEngine::attach(std::vector<Literal> const & literals, bool learned)
+{
+    assert(literals.size() >= 2);
+    int index = (int)clauses_.size();
+    clauses_.push_back({ (int)literals_.size(), (int)literals.size(), learned, 0.0 });
+    literals_.insert(literals_.end(), literals.begin(), literals.end());
+    watches_[literals[0]].push_back(index);
+    watches_[literals[1]].push_back(index);
+    if (learned)
+        ++learnedCount_;
+    return index;
+}
+
+// Adds clauses that limit the number of cards the player holds. Variable r(i, j) is true if the player holds at least j of
+// the first i cards, so r(i, j) = r(i - 1, j) or (r(i - 1, j - 1) and the player holds card i). Only counts up to one more
+// than the most cards are needed.
+void ClauseEngine::addCounter(int player, int minCards, int maxCards)
+{
+    int limit = std::min(maxCards + 1, cards_);
+    std::vector<std::vector<Literal>> r(cards_ + 1);
+    auto count = [&] (int i, int j) -> Literal {
+        if (j == 0)
+            return TRUE_LITERAL;
+        if (i == 0 || j > i || j > limit)
+            return FALSE_LITERAL;
+        return r[i][j];
+    };
+
+    for (int i = 1; i <= cards_; ++i)
+    {
+        Literal holds = positive(cell(player, i - 1));
+        r[i].resize(std::min(i, limit) + 1);
+        for (int j = 1; j <= std::min(i, limit); ++j)
+        {
+            r[i][j]           = positive(newVariable());
+            Literal atLeast   = count(i, j);
+            Literal before    = count(i - 1, j);
+            Literal oneFewer  = count(i - 1, j - 1);
+            addClause({ negate(before), atLeast });
+            addClause({ negate(oneFewer), negate(holds), atLeast });
+            addClause({ negate(atLeast), before, oneFewer });
+            addClause({ negate(atLeast), before, holds });
+        }
+    }
+
+    if (maxCards + 1 <= cards_)
+        addClause({ negate(count(cards_, maxCards + 1)) });
+    if (minCards > 0)
+        addClause({ count(cards_, minCards) });
+}
+
+int ClauseEngine::newVariable()
+{
+    int variable = (int)values_.size();
+    values_.push_back(0);
+    phases_.push_back(1);
+    levels_.push_back(0);
+    reasons_.push_back(-1);
+    activity_.push_back(0.0);
+    seen_.push_back(0);
+    watches_.resize(watches_.size() + 2);
+    return variable;
+}
+
+// Searches for an assignment satisfying all the clauses and the assumptions. Returns true if one is found. Either way,
+// the assignment is left in place until the caller backtracks.
+bool ClauseEngine::solve(std::vector<Literal> const & assumptions)
+{
+    if (contradiction_)
+        return false;
+
+    std::vector<Literal> learned;
+    int                  conflicts    = 0;
+    int                  restartLimit = FIRST_RESTART;
+    while (true)
+    {
+        int conflict = propagate();
+        if (conflict >= 0)
+        {
+            if (level() == 0)
+            {
+                contradiction_ = true;
+                return false;
+            }
+
+            int backjumpLevel;
+            analyze(conflict, learned, backjumpLevel);
+            backtrack(backjumpLevel);
+            if (learned.size() == 1)
+                assign(learned[0], -1);
+            else
+                assign(learned[0], attach(learned, true));
+            variableIncrement_ /= VARIABLE_DECAY;
+            clauseIncrement_   /= CLAUSE_DECAY;
+            ++conflicts;
+            continue;
+        }
+
+        if (conflicts >= restartLimit)
+        {
+            backtrack(0);
+            conflicts    = 0;
+            restartLimit = restartLimit * 3 / 2;
+            continue;
+        }
+
+        // The assumptions are the first decisions, one per level. One that is already false cannot be satisfied along
+        // with the clauses and the assumptions before it.
+        Literal next;
+        if (level() < (int)assumptions.size())
+        {
+            Literal assumption = assumptions[level()];
+            if (value(assumption) < 0)
+                return false;
+            if (value(assumption) > 0)
+            {
+                trailLimits_.push_back((int)trail_.size());
+                continue;
+            }
+            next = assumption;
+        }
+        else
+        {
+            next = pick();
+            if (next < 0)
+                return true;
+        }
+        trailLimits_.push_back((int)trail_.size());
+        assign(next, -1);
+    }
+}
+
+// Assigns the literals implied by the clauses. Returns the index of a clause with all its literals false, or -1.
+int ClauseEngine::propagate()
+{
+    while (head_ < trail_.size())
+    {
+        Literal            falsified = negate(trail_[head_++]);
+        std::vector<int> & watchers  = watches_[falsified];
+        size_t             i         = 0;
+        size_t             j         = 0;
+        while (i < watchers.size())
+        {
+            int       index = watchers[i++];
+            Clause &  c     = clauses_[index];
+            Literal * l     = &literals_[c.start];
+            if (l[0] == falsified)
+                std::swap(l[0], l[1]);
+            if (value(l[0]) > 0)
+            {
+                watchers[j++] = index;
+                continue;
+            }
+
+            // Watch another literal that is not false, if there is one
+            bool moved = false;
+            for (int k = 2; k < c.size; ++k)
+            {
+                if (value(l[k]) >= 0)
+                {
+                    std::swap(l[1], l[k]);
+                    watches_[l[1]].push_back(index);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved)
+                continue;
+
+            watchers[j++] = index;
+            if (value(l[0]) < 0)
+            {
+                while (i < watchers.size())
+                {
+                    watchers[j++] = watchers[i++];
+                }
+                watchers.resize(j);
+                head_ = trail_.size();
+                return index;
+            }
+            assign(l[0], index);
+        }
+        watchers.resize(j);
+    }
+    return -1;
+}
+
+// Finds the clause to learn from a conflict (the first unique implication point) and the level to go back to, at which
+// the first literal of the clause is implied
+void ClauseEngine::analyze(int conflict, std::vector<Literal> & learned, int & backjumpLevel)
+{
+    learned.clear();
+    learned.push_back(-1);
+    int     paths = 0;
+    Literal implied = -1;
+    int     next    = (int)trail_.size() - 1;
+    int     index   = conflict;
+    do
+    {
+        Clause & c = clauses_[index];
+        if (c.learned)
+        {
+            c.activity += clauseIncrement_;
+            if (c.activity > RESCALE_LIMIT)
+            {
+                for (auto & d : clauses_)
+                {
+                    d.activity /= RESCALE_LIMIT;
+                }
+                clauseIncrement_ /= RESCALE_LIMIT;
+            }
+        }
+        for (int k = (implied < 0) ? 0 : 1; k < c.size; ++k)
+        {
+            Literal l = literals_[c.start + k];
+            int     v = variableOf(l);
+            if (!seen_[v] && levels_[v] > 0)
+            {
+                seen_[v] = 1;
+                bump(v);
+                if (levels_[v] >= level())
+                    ++paths;
+                else
+                    learned.push_back(l);
+            }
+        }
+
+        while (!seen_[variableOf(trail_[next])])
+        {
+            --next;
+        }
+        implied = trail_[next--];
+        index   = reasons_[variableOf(implied)];
+        seen_[variableOf(implied)] = 0;
+        --paths;
+    } while (paths > 0);
+    learned[0] = negate(implied);
+
+    backjumpLevel = 0;
+    for (size_t i = 1; i < learned.size(); ++i)
+    {
+        int v = variableOf(learned[i]);
+        seen_[v] = 0;
+        if (levels_[v] > backjumpLevel)
+        {
+            backjumpLevel = levels_[v];
+            std::swap(learned[1], learned[i]);
+        }
+    }
+}
+
+void ClauseEngine::assign(Literal literal, int reason)
+{
+    int v = variableOf(literal);
+    assert(values_[v] == 0);
+    values_[v]  = (literal & 1) ? -1 : 1;
+    levels_[v]  = level();
+    reasons_[v] = reason;
+    trail_.push_back(literal);
+}
+
+void ClauseEngine::backtrack(int level)
+{
+    if (this->level() <= level)
+        return;
+    while ((int)trail_.size() > trailLimits_[level])
+    {
+        int v = variableOf(trail_.back());
+        phases_[v] = values_[v];
+        values_[v] = 0;
+        trail_.pop_back();
+    }
+    trailLimits_.resize(level);
+    head_ = trail_.size();
+}
+
+// Returns the literal to decide next: the unassigned cell most involved in recent conflicts, with the value it last had.
+// Cells that were last true come first, since deciding that a player holds a card settles the card's other holders, and
+// the holders in the last deal found are likely to be consistent again. Once the cells are assigned, propagation assigns
+// the counters, but any left are assigned too.
+ClauseEngine::Literal ClauseEngine::pick() const
+{
+    int    best     = -1;
+    bool   held     = false;
+    double activity = -1.0;
+    for (int v = 0; v < players_ * cards_; ++v)
+    {
+        if (values_[v] == 0 && std::make_pair(phases_[v] > 0, activity_[v]) > std::make_pair(held, activity))
+        {
+            best     = v;
+            held     = phases_[v] > 0;
+            activity = activity_[v];
+        }
+    }
+    for (int v = players_ * cards_; best < 0 && v < (int)values_.size(); ++v)
+    {
+        if (values_[v] == 0)
+            best = v;
+    }
+    if (best < 0)
+        return -1;
+    return (phases_[best] > 0) ? positive(best) : negative(best);
+}
+
+void ClauseEngine::bump(int variable)
+{
+    activity_[variable] += variableIncrement_;
+    if (activity_[variable] > RESCALE_LIMIT)
+    {
+        for (auto & a : activity_)
+        {
+            a /= RESCALE_LIMIT;
+        }
+        variableIncrement_ /= RESCALE_LIMIT;
+    }
+}
+
+// Drops the less active half of the learned clauses and every clause that is already satisfied, and removes the literals
+// that are already false from the rest. This is done at decision level 0, where no clause is needed as the reason for an
+// assignment, and every clause that is not satisfied is left with at least two literals.
+void ClauseEngine::reduce()
+{
+    assert(level() == 0);
+    std::vector<double> activities;
+    for (auto const & c : clauses_)
+    {
+        if (c.learned)
+            activities.push_back(c.activity);
+    }
+    std::nth_element(activities.begin(), activities.begin() + activities.size() / 2, activities.end());
+    double median = activities[activities.size() / 2];
+
+    std::vector<Clause>  clauses;
+    std::vector<Literal> literals;
+    learnedCount_ = 0;
+    for (auto const & c : clauses_)
+    {
+        bool satisfied = false;
+        for (int k = 0; k < c.size && !satisfied; ++k)
+        {
+            satisfied = value(literals_[c.start + k]) > 0;
+        }
+        if (satisfied || (c.learned && c.activity < median))
+            continue;
+
+        int start = (int)literals.size();
+        for (int k = 0; k < c.size; ++k)
+        {
+            if (value(literals_[c.start + k]) == 0)
+                literals.push_back(literals_[c.start + k]);
+        }
+        assert(literals.size() - start >= 2);
+        clauses.push_back({ start, (int)literals.size() - start, c.learned, c.activity });
+        if (c.learned)
+            ++learnedCount_;
+    }
+    clauses_.swap(clauses);
+    literals_.swap(literals);
+
+    for (auto & w : watches_)
+    {
+        w.clear();
+    }
+    for (int i = 0; i < (int)clauses_.size(); ++i)
+    {
+        watches_[literals_[clauses_[i].start]].push_back(i);
+        watches_[literals_[clauses_[i].start + 1]].push_back(i);
+    }
+    std::fill(reasons_.begin(), reasons_.end(), -1);
+    learnedLimit_ += learnedLimit_ / 10;
+}
+
+int ClauseEngine::value(Literal literal) const
+{
+    int v = values_[variableOf(literal)];
+    return (literal & 1) ? -v : v;
+}
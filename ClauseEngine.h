@@ -0,0 +1,101 @@
+#pragma once
+#if !defined(CLAUSEENGINE_H)
+#define CLAUSEENGINE_H 1
+
+#include "Constraints.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Finds every fact implied by the constraints on the deal by encoding them as clauses and testing each cell with a small
+//! CDCL satisfiability solver.
+//!
+//! There is a variable for each cell (a player holding a card), and the constraints become clauses: every card has
+//! exactly one holder, the answer holds exactly one card of each type, each player's number of cards is within its limits
+//! (counted in unary with auxiliary variables), and the constraints' own clauses. A card that a player might hold is
+//! excluded if assuming that the player holds it leads to a contradiction. Each test starts with unit propagation over
+//! two watched literals per clause, which settles most of them (failed-literal probing), and the rest are settled by a
+//! search that learns a clause from every conflict. Every solution found along the way is a consistent deal, so the cells
+//! it assigns are known to be possible and are not tested.
+//!
+//! The engine is incremental. update() adds the constraints that are new since the last call, and the learned clauses are
+//! kept, so that each event costs little. Constraints can only be added: if any are taken away (by undoing an event) or
+//! the limits on the number of cards change, the engine has to be rebuilt.
+class ClauseEngine
+{
+public:
+    //! Constructor
+    explicit ClauseEngine(Constraints const & constraints);
+
+    //! Adds the constraints that are not already in the engine. Returns false if the engine cannot be updated because
+    //! some of its constraints are no longer there or the limits on the number of cards have changed.
+    bool update(Constraints const & constraints);
+
+    //! Returns the cards that each player might hold according to the constraints but does not hold in any consistent
+    //! deal, by player index. Nothing is excluded if there is no consistent deal.
+    std::vector<uint64_t> excluded();
+
+    //! Returns true if there is a consistent deal in which the player holds all of the cards. If there is, the cards that
+    //! the player holds in it are stored in held.
+    bool allows(int player, uint64_t cards, uint64_t & held);
+
+private:
+    using Literal = int;        // Twice the variable index, plus 1 if the variable is negated
+
+    struct Clause
+    {
+        int start;              // Index of the first literal in literals_
+        int size;
+        bool learned;
+        double activity;        // How recently the clause took part in conflicts (learned clauses only)
+    };
+
+    void addClause(std::vector<Literal> literals);
+    int  attach(std::vector<Literal> const & literals, bool learned);
+    void addCounter(int player, int minCards, int maxCards);
+    int  newVariable();
+
+    bool solve(std::vector<Literal> const & assumptions);
+    int  propagate();
+    void analyze(int conflict, std::vector<Literal> & learned, int & backjumpLevel);
+    void assign(Literal literal, int reason);
+    void backtrack(int level);
+    Literal pick() const;
+    void bump(int variable);
+    void reduce();
+
+    int  level() const { return (int)trailLimits_.size(); }
+    int  value(Literal literal) const;
+    int  cell(int player, int card) const { return player * cards_ + card; }
+
+    int players_;
+    int cards_;
+    int answer_;
+    std::vector<uint64_t> possible_;            // Cards each player might hold, as of the latest update
+    std::vector<int> minCards_;
+    std::vector<int> maxCards_;
+    std::vector<Constraints::HoldsOneOf> holdsOneOf_;
+    std::vector<uint64_t> answerNotAll_;
+    bool contradiction_;                        // True if the clauses cannot all be satisfied
+
+    std::vector<Clause> clauses_;
+    std::vector<Literal> literals_;             // Literals of all the clauses
+    std::vector<std::vector<int>> watches_;     // Clauses watching each literal, by literal
+    int learnedCount_;
+    int learnedLimit_;                          // Learned clauses are reduced when there are more than this
+
+    std::vector<int8_t> values_;                // Value of each variable: 1 (true), -1 (false) or 0 (not assigned)
+    std::vector<int8_t> phases_;                // Value each variable had when it was last assigned
+    std::vector<int> levels_;                   // Decision level at which each variable was assigned
+    std::vector<int> reasons_;                  // Clause that implied each variable, or -1
+    std::vector<double> activity_;              // How recently each variable took part in conflicts
+    double variableIncrement_;
+    double clauseIncrement_;
+    std::vector<Literal> trail_;                // Assigned literals in order
+    std::vector<int> trailLimits_;              // Start of each decision level in the trail
+    size_t head_;                               // Next literal in the trail to propagate
+    std::vector<char> seen_;                    // Variables seen in conflict analysis
+};
+
+#endif // !defined(CLAUSEENGINE_H)
@@ -0,0 +1,119 @@
+#include "Configuration.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+Configuration::Configuration()
+    : rules("classic")
+    , types({
+        { "suspect",    { "Suspects", "",      ""     } },
+        { "weapon",     { "Weapons",  "with ", "the " } },
+        { "room",       { "Rooms",    "in ",   "the " } }
+    })
+    , cards({
+        { "mustard",      { "Colonel Mustard", "suspect" } },
+        { "white",        { "Mrs. White",      "suspect" } },
+        { "plum",         { "Professor Plum",  "suspect" } },
+        { "peacock",      { "Mrs. Peacock",    "suspect" } },
+        { "green",        { "Mr. Green",       "suspect" } },
+        { "scarlet",      { "Miss Scarlet",    "suspect" } },
+        { "revolver",     { "Revolver",        "weapon"  } },
+        { "knife",        { "Knife",           "weapon"  } },
+        { "rope",         { "Rope",            "weapon"  } },
+        { "pipe",         { "Lead pipe",       "weapon"  } },
+        { "wrench",       { "Wrench",          "weapon"  } },
+        { "candlestick",  { "Candlestick",     "weapon"  } },
+        { "dining",       { "Dining room",     "room"    } },
+        { "conservatory", { "Conservatory",    "room"    } },
+        { "kitchen",      { "Kitchen",         "room"    } },
+        { "study",        { "Study",           "room"    } },
+        { "library",      { "Library",         "room"    } },
+        { "billiard",     { "Billiard room",   "room"    } },
+        { "lounge",       { "Lounge",          "room"    } },
+        { "ballroom",     { "Ballroom",        "room"    } },
+        { "hall",         { "Hall",            "room"    } }
+    })
+{
+    buildTables();
+}
+
+//    {
+//        "types" : [
+//            { "id" : "suspect", "title" : "Suspects", "article" : "",     "preposition" : ""      },
+//            { "id" : "weapon",  "title" : "Weapons",  "article" : "the ", "preposition" : "with " },
+//            { "id" : "room",    "title" : "Rooms",    "article" : "the ",  preposition" : "in "   }
+//        ]
+// }
+//    {
+//        "cards" : [
+//            { "id" : "mustard", "name" : "Colonel Mustard", "type" : "suspect" },
+//            { "id" : "knife",   "name" : "Knife",           "type" : "weapon" },
+//            { "id" : "studio",  "name" : "Studio",          "type" : "room" }
+//        ]
+// }
+
+bool Configuration::load(char const * name)
+{
+    std::ifstream file(name);
+    if (!file.is_open())
+        return false;
+
+    try
+    {
+        json j;
+        file >> j;
+
+        rules = j["rules"];
+        types.clear();
+        cards.clear();
+
+        json jtypes = j["types"];
+        for (auto const & a : jtypes)
+        {
+            if (a.find("id") == a.end() ||
+                a.find("title") == a.end() ||
+                a.find("article") == a.end() ||
+                a.find("preposition") == a.end())
+            {
+                throw std::domain_error("Invalid card type, missing information.");
+            }
+
+            Solver::TypeInfo type = { a["title"], a["article"], a["preposition"] };
+            types[a["id"]] = type;
+        }
+
+        json jcards = j["cards"];
+        for (auto const & c : jcards)
+        {
+            if (c.find("id") == c.end() || c.find("name") == c.end() || c.find("type") == c.end())
+                throw std::domain_error("Invalid card configuration.");
+
+            Solver::CardInfo card = { c["name"], c["type"] };
+            if (types.find(card.type) == types.end())
+                throw std::domain_error("Invalid card configuration, unknown type.");
+            cards[c["id"]] = card;
+        }
+        if (cards.size() > Solver::MAX_CARDS)
+            throw std::domain_error("Invalid card configuration, too many cards.");
+        buildTables();
+    }
+    catch (std::exception const & e)
+    {
+        std::cout << "Failed to load configuration file: " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Configuration::buildTables()
+{
+    Solver::Rules r = { rules, types, cards, {}, {} };
+    Solver::buildTables(r);
+    typeTable = r.typeTable;
+    cardTable = r.cardTable;
+}
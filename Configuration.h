@@ -0,0 +1,39 @@
+#pragma once
+#if !defined(CONFIGURATION_H)
+#define CONFIGURATION_H 1
+
+#include "Solver.h"
+
+#include <memory>
+#include <string>
+
+//! The rules, card types, and cards used by a game. A configuration is not changed once it is loaded, so it can be shared
+//! by any number of games running at the same time.
+struct Configuration
+{
+    std::string rules;              //!< ID of the rules ("classic" or "master")
+    Solver::TypeInfoList types;     //!< Card types by ID
+    Solver::CardInfoList cards;     //!< Cards by ID
+    std::shared_ptr<SymbolTable const> typeTable;   //!< Type IDs, interned in order of ID when the types are loaded
+    std::shared_ptr<SymbolTable const> cardTable;   //!< Card IDs, interned in order of ID when the cards are loaded
+
+    //! Constructor. The configuration is the Classic Clue configuration.
+    Configuration();
+
+    //! Loads the configuration from a JSON file, returning false if it could not be loaded
+    bool load(char const * name);
+
+    //! Interns the IDs of the types and cards (see typeTable and cardTable). The constructor and load() do this.
+    void buildTables();
+
+    //! Returns the rules in the form used by the solver
+    Solver::Rules solverRules() const { return { rules, types, cards, typeTable, cardTable }; }
+
+    //! Returns info about a card, which must exist
+    Solver::CardInfo const & card(Solver::Id const & id) const { return cards.at(id); }
+
+    //! Returns info about the type of a card, which must exist
+    Solver::TypeInfo const & typeOf(Solver::Id const & id) const { return types.at(card(id).type); }
+};
+
+#endif // !defined(CONFIGURATION_H)
@@ -0,0 +1,34 @@
+#pragma once
+#if !defined(CONSTRAINTS_H)
+#define CONSTRAINTS_H 1
+
+#include <cstdint>
+#include <vector>
+
+//! Constraints on how the cards could have been dealt, in terms of player and card indexes.
+//!
+//! A deal assigns every card to exactly one player (or the answer). A deal is consistent if every card is held by a player
+//! that might hold it, every player holds a number of cards within its limits, the answer holds exactly one card of each
+//! type, and all of the clauses are satisfied.
+struct Constraints
+{
+    //! The player holds at least one of the cards
+    struct HoldsOneOf
+    {
+        int player;
+        uint64_t cards;
+    };
+
+    int answer;                             //!< Index of the answer
+    std::vector<uint64_t> possible;         //!< Cards each player might be holding, by player index
+    std::vector<int> minCards;              //!< Fewest cards each player can hold, by player index
+    std::vector<int> maxCards;              //!< Most cards each player can hold, by player index
+    std::vector<uint64_t> types;            //!< Cards of each type, by type index
+    std::vector<HoldsOneOf> holdsOneOf;     //!< Players that must hold at least one of a set of cards
+    std::vector<uint64_t> answerNotAll;     //!< Sets of cards that the answer does not hold all of
+
+    //! Returns the number of players (including the answer)
+    int playerCount() const { return (int)possible.size(); }
+};
+
+#endif // !defined(CONSTRAINTS_H)
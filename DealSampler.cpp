@@ -0,0 +1,479 @@
+#include "DealSampler.h"
+
+#include "Bits.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+int const MAX_CYCLE           = 5;        // Most players that cards are passed between in one step
+int const BURN_IN_SWEEPS      = 20;       // Sweeps made before the first sample is taken
+int const SAMPLES_PER_FLUSH   = 256;      // Samples tallied locally before they are added to the shared counters
+int const SEARCH_LIMIT        = 100000;   // Most assignments tried in one search for a consistent deal
+int const SEARCH_ATTEMPTS     = 20;       // Most searches for a consistent deal
+} // anonymous namespace
+
+//! The state of one worker's Markov chain
+class DealSampler::Chain
+{
+public:
+    Chain(DealSampler const & sampler, std::vector<int> const & holders)
+        : sampler_(sampler)
+        , constraints_(sampler.constraints_)
+        , holders_(holders)
+        , hands_(constraints_.playerCount(), 0)
+    {
+        for (size_t c = 0; c < holders_.size(); ++c)
+        {
+            hands_[holders_[c]] |= bit((int)c);
+        }
+    }
+
+    // Proposes a change to the deal and makes it if the result is consistent
+    void step(std::mt19937_64 & rng)
+    {
+        std::vector<int> const & unknown = sampler_.unknown_;
+        std::uniform_int_distribution<size_t> pickCard(0, unknown.size() - 1);
+
+        if (rng() & 1)
+        {
+            // Pass cards around a cycle of players, each card going to the holder of the next one. Swapping pairs is not
+            // enough because some changes can't be made without passing through an inconsistent deal (for example, when
+            // players' hand sizes are fixed and the answer must trade cards of the same type through other players).
+            // Picking the same cycle in reverse undoes the change, so the proposal is symmetric.
+            std::uniform_int_distribution<int> pickLength(2, MAX_CYCLE);
+            int      length = pickLength(rng);
+            int      cards[MAX_CYCLE];
+            int      players[MAX_CYCLE];
+            uint64_t involved = 0;
+            for (int i = 0; i < length; ++i)
+            {
+                cards[i]   = unknown[pickCard(rng)];
+                players[i] = holders_[cards[i]];
+                if (involved & bit(players[i]))
+                    return;
+                involved |= bit(players[i]);
+            }
+            for (int i = 0; i < length; ++i)
+            {
+                if (!(constraints_.possible[players[(i + 1) % length]] & bit(cards[i])))
+                    return;
+            }
+            pass(cards, players, length);
+            bool valid = true;
+            for (int i = 0; i < length && valid; ++i)
+            {
+                valid = consistent(players[i]);
+            }
+            if (!valid)
+                unpass(cards, players, length);
+        }
+        else
+        {
+            // Move a card to another player
+            int c = unknown[pickCard(rng)];
+            int p = holders_[c];
+            std::uniform_int_distribution<int> pickPlayer(0, constraints_.playerCount() - 2);
+            int q = pickPlayer(rng);
+            if (q >= p)
+                ++q;
+            if (!(constraints_.possible[q] & bit(c)))
+                return;
+            hands_[p] &= ~bit(c);
+            hands_[q] |= bit(c);
+            if (consistent(p) && consistent(q))
+            {
+                holders_[c] = q;
+            }
+            else
+            {
+                hands_[p] |= bit(c);
+                hands_[q] &= ~bit(c);
+            }
+        }
+    }
+
+    // Returns the holder of each card
+    std::vector<int> const & holders() const { return holders_; }
+
+private:
+    // Gives each card to the holder of the next card in the cycle
+    void pass(int const * cards, int const * players, int length)
+    {
+        for (int i = 0; i < length; ++i)
+        {
+            int to = players[(i + 1) % length];
+            hands_[players[i]] &= ~bit(cards[i]);
+            hands_[to]         |= bit(cards[i]);
+            holders_[cards[i]]  = to;
+        }
+    }
+
+    // Undoes pass()
+    void unpass(int const * cards, int const * players, int length)
+    {
+        for (int i = 0; i < length; ++i)
+        {
+            int to = players[(i + 1) % length];
+            hands_[to]         &= ~bit(cards[i]);
+            hands_[players[i]] |= bit(cards[i]);
+            holders_[cards[i]]  = players[i];
+        }
+    }
+
+    // Returns true if the player's hand is consistent with the constraints
+    bool consistent(int player) const
+    {
+        uint64_t hand  = hands_[player];
+        int      count = countBits(hand);
+        if (count < constraints_.minCards[player] || count > constraints_.maxCards[player])
+            return false;
+        for (auto clause : sampler_.clauses_[player])
+        {
+            if ((hand & clause) == 0)
+                return false;
+        }
+        if (player == constraints_.answer)
+        {
+            for (auto t : constraints_.types)
+            {
+                if (countBits(hand & t) != 1)
+                    return false;
+            }
+            for (auto cards : constraints_.answerNotAll)
+            {
+                if ((hand & cards) == cards)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    DealSampler const & sampler_;
+    Constraints const & constraints_;
+    std::vector<int> holders_;
+    std::vector<uint64_t> hands_;
+};
+
+DealSampler::DealSampler(Constraints const & constraints)
+    : constraints_(constraints)
+    , cardCount_(0)
+    , total_(0)
+    , stop_(false)
+    , samples_(0)
+{
+    for (size_t t = 0; t < constraints_.types.size(); ++t)
+    {
+        forEachBit(constraints_.types[t], [&] (int c) {
+            cardCount_ = std::max(cardCount_, c + 1);
+        });
+    }
+    types_.resize(cardCount_);
+    for (size_t t = 0; t < constraints_.types.size(); ++t)
+    {
+        forEachBit(constraints_.types[t], [&] (int c) { types_[c] = (int)t; });
+    }
+
+    for (int c = 0; c < cardCount_; ++c)
+    {
+        int holders = 0;
+        for (auto p : constraints_.possible)
+        {
+            holders += (p & bit(c)) ? 1 : 0;
+        }
+        if (holders > 1)
+            unknown_.push_back(c);
+    }
+
+    clauses_.resize(constraints_.playerCount());
+    for (auto const & h : constraints_.holdsOneOf)
+    {
+        clauses_[h.player].push_back(h.cards);
+    }
+}
+
+std::vector<std::vector<double>> DealSampler::probabilities(Options const & options)
+{
+    int                              n = constraints_.playerCount();
+    std::vector<std::vector<double>> result(n, std::vector<double>(cardCount_, 0.0));
+
+    total_   = 0;
+    stop_    = false;
+    samples_ = 0;
+
+    Counters hits(new std::atomic<uint64_t>[n * cardCount_]);
+    Counters squares(new std::atomic<uint64_t>[n * cardCount_]);
+    for (int i = 0; i < n * cardCount_; ++i)
+    {
+        hits[i]    = 0;
+        squares[i] = 0;
+    }
+
+    // If every holder is known, there is nothing to sample but the deal must still be consistent
+    if (unknown_.empty())
+    {
+        std::mt19937_64  rng(options.seed);
+        std::vector<int> holders;
+        if (findDeal(rng, holders))
+        {
+            samples_ = 1;
+            for (int c = 0; c < cardCount_; ++c)
+            {
+                result[holders[c]][c] = 1.0;
+            }
+        }
+        return result;
+    }
+
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(&DealSampler::work, this, i, std::cref(options), std::ref(hits), std::ref(squares));
+    }
+    for (auto & w : workers)
+    {
+        w.join();
+    }
+
+    samples_ = total_;
+    if (samples_ == 0)
+        return result;
+
+    for (int c = 0; c < cardCount_; ++c)
+    {
+        for (int p = 0; p < n; ++p)
+        {
+            if (constraints_.possible[p] & bit(c))
+            {
+                if (std::find(unknown_.begin(), unknown_.end(), c) == unknown_.end())
+                    result[p][c] = 1.0;
+                else
+                    result[p][c] = (double)hits[p * cardCount_ + c] / (double)samples_;
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::vector<int>> DealSampler::deals(int count, uint64_t seed) const
+{
+    std::vector<std::vector<int>> result;
+    std::mt19937_64               rng(seed);
+    std::vector<int>              holders;
+    if (!findDeal(rng, holders))
+        return result;
+    if (unknown_.empty())
+        return std::vector<std::vector<int>>(count, holders);
+
+    Chain chain(*this, holders);
+    int   sweep = (int)unknown_.size();
+    for (int i = 0; i < BURN_IN_SWEEPS * sweep; ++i)
+    {
+        chain.step(rng);
+    }
+    result.reserve(count);
+    for (int d = 0; d < count; ++d)
+    {
+        for (int i = 0; i < sweep; ++i)
+        {
+            chain.step(rng);
+        }
+        result.push_back(chain.holders());
+    }
+    return result;
+}
+
+bool DealSampler::findDeal(std::mt19937_64 & rng, std::vector<int> & holders) const
+{
+    int n = constraints_.playerCount();
+
+    for (int attempt = 0; attempt < SEARCH_ATTEMPTS; ++attempt)
+    {
+        holders.assign(cardCount_, -1);
+        std::vector<uint64_t> hands(n, 0);
+        std::vector<int>      order;
+        for (int c = 0; c < cardCount_; ++c)
+        {
+            uint64_t m = 0;
+            for (int p = 0; p < n; ++p)
+            {
+                if (constraints_.possible[p] & bit(c))
+                    m |= bit(p);
+            }
+            if (m == 0)
+                return false;
+            if (countBits(m) == 1)
+            {
+                holders[c] = lowestBit(m);
+                hands[holders[c]] |= bit(c);
+            }
+            else
+            {
+                order.push_back(c);
+            }
+        }
+
+        // Assign the cards with the fewest possible holders first, breaking ties randomly
+        std::shuffle(order.begin(), order.end(), rng);
+        std::stable_sort(order.begin(), order.end(), [&] (int a, int b) {
+            int ha = 0;
+            int hb = 0;
+            for (auto p : constraints_.possible)
+            {
+                ha += (p & bit(a)) ? 1 : 0;
+                hb += (p & bit(b)) ? 1 : 0;
+            }
+            return ha < hb;
+        });
+
+        int nodes = 0;
+
+        uint64_t assigned = 0;
+        for (int c = 0; c < cardCount_; ++c)
+        {
+            if (holders[c] >= 0)
+                assigned |= bit(c);
+        }
+
+        auto search = [&] (auto & self, size_t i) -> bool {
+            if (++nodes > SEARCH_LIMIT)
+                return false;
+
+            // Every player must still be able to reach its minimum number of cards
+            int shortfall = 0;
+            for (int p = 0; p < n; ++p)
+            {
+                shortfall += std::max(0, constraints_.minCards[p] - countBits(hands[p]));
+            }
+            if (shortfall > (int)(order.size() - i))
+                return false;
+
+            // Every clause whose cards have all been dealt must be satisfied
+            for (int p = 0; p < n; ++p)
+            {
+                for (auto clause : clauses_[p])
+                {
+                    if ((clause & ~assigned) == 0 && (hands[p] & clause) == 0)
+                        return false;
+                }
+            }
+            for (auto cards : constraints_.answerNotAll)
+            {
+                if ((hands[constraints_.answer] & cards) == cards)
+                    return false;
+            }
+
+            if (i == order.size())
+                return true;
+
+            int              c = order[i];
+            std::vector<int> candidates;
+            for (int p = 0; p < n; ++p)
+            {
+                if (!(constraints_.possible[p] & bit(c)) || countBits(hands[p]) >= constraints_.maxCards[p])
+                    continue;
+                if (p == constraints_.answer && (hands[p] & constraints_.types[types_[c]]))
+                    continue;   // The answer holds only one card of each type
+                candidates.push_back(p);
+            }
+            std::shuffle(candidates.begin(), candidates.end(), rng);
+
+            for (auto p : candidates)
+            {
+                holders[c] = p;
+                hands[p]  |= bit(c);
+                assigned  |= bit(c);
+                if (self(self, i + 1))
+                    return true;
+                hands[p]  &= ~bit(c);
+                assigned  &= ~bit(c);
+            }
+            holders[c] = -1;
+            return false;
+        };
+
+        if (search(search, 0))
+            return true;
+        if (nodes <= SEARCH_LIMIT)
+            return false;   // The search was exhaustive, so there is no consistent deal
+    }
+    return false;
+}
+
+void DealSampler::work(int worker, Options const & options, Counters & hits, Counters & squares)
+{
+    std::seed_seq   seed{ options.seed, (uint64_t)worker };
+    std::mt19937_64 rng(seed);
+
+    std::vector<int> holders;
+    if (!findDeal(rng, holders))
+        return;
+    Chain chain(*this, holders);
+    int   sweep = (int)unknown_.size();
+    for (int i = 0; i < BURN_IN_SWEEPS * sweep; ++i)
+    {
+        chain.step(rng);
+    }
+
+    int                   n = constraints_.playerCount();
+    std::vector<uint64_t> local(n * cardCount_, 0);
+    uint64_t              count = 0;
+    while (!stop_)
+    {
+        for (int i = 0; i < sweep; ++i)
+        {
+            chain.step(rng);
+        }
+        for (auto c : unknown_)
+        {
+            ++local[chain.holders()[c] * cardCount_ + c];
+        }
+
+        if (++count == SAMPLES_PER_FLUSH)
+        {
+            for (size_t i = 0; i < local.size(); ++i)
+            {
+                if (local[i] > 0)
+                {
+                    hits[i].fetch_add(local[i], std::memory_order_relaxed);
+                    squares[i].fetch_add(local[i] * local[i], std::memory_order_relaxed);
+                    local[i] = 0;
+                }
+            }
+            total_.fetch_add(count);
+            count = 0;
+            if (done(options, hits, squares))
+                stop_ = true;
+        }
+    }
+}
+
+// Returns true if enough samples have been taken
+bool DealSampler::done(Options const & options, Counters const & hits, Counters const & squares) const
+{
+    uint64_t total = total_;
+    if (total >= options.maxSamples)
+        return true;
+    if (total < options.minSamples)
+        return false;
+
+    // Successive samples from a chain are correlated, so the error is estimated from the variance of the batches of
+    // samples that the workers add to the counters (the method of batch means) rather than from the individual samples.
+    double batches  = (double)(total / SAMPLES_PER_FLUSH);
+    int    n        = constraints_.playerCount();
+    double variance = 0.0;
+    for (int p = 0; p < n; ++p)
+    {
+        for (auto c : unknown_)
+        {
+            int    i    = p * cardCount_ + c;
+            double mean  = (double)hits[i].load(std::memory_order_relaxed) / batches;
+            double mean2 = (double)squares[i].load(std::memory_order_relaxed) / batches;
+            variance = std::max(variance, mean2 - mean * mean);
+        }
+    }
+    return std::sqrt(variance / batches) / SAMPLES_PER_FLUSH <= options.maxError;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#if !defined(DEALSAMPLER_H)
+#define DEALSAMPLER_H 1
+
+#include "Constraints.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+//! Estimates the probability of every player holding every card by sampling deals consistent with the constraints.
+//!
+//! Each worker thread runs its own Markov chain over the consistent deals with its own random number generator. A step
+//! proposes either passing cards around a cycle of players or moving a card to another player, and the proposal is
+//! accepted if the resulting deal is consistent, so every consistent deal is equally likely in the long run. The workers
+//! tally their samples locally and periodically add them to shared atomic counters, so they never wait on each other.
+class DealSampler
+{
+public:
+    //! Sampling options
+    struct Options
+    {
+        int threads;            //!< Number of worker threads (0 means one per hardware thread)
+        uint64_t maxSamples;    //!< Most samples to take
+        uint64_t minSamples;    //!< Fewest samples to take before checking the error
+        double maxError;        //!< Sampling stops once the standard error of every probability is below this
+        uint64_t seed;          //!< Seed for the random number generators
+
+        Options() : threads(0), maxSamples(1000000), minSamples(10000), maxError(0.005), seed(0) {}
+    };
+
+    //! Constructor
+    explicit DealSampler(Constraints const & constraints);
+
+    //! Returns the estimated probability of each player holding each card, by player index and card index. All
+    //! probabilities are 0 if no consistent deal could be found.
+    std::vector<std::vector<double>> probabilities(Options const & options = Options());
+
+    //! Returns the number of samples taken by the last call to probabilities()
+    uint64_t samples() const { return samples_; }
+
+    //! Returns random consistent deals, taken one sweep apart from a single chain. The holder of each card is returned by
+    //! card index. No deals are returned if no consistent deal could be found.
+    std::vector<std::vector<int>> deals(int count, uint64_t seed) const;
+
+    //! Finds a random consistent deal, returning false if there is none (or none was found within the search limit).
+    //! The holder of each card is returned by card index.
+    bool findDeal(std::mt19937_64 & rng, std::vector<int> & holders) const;
+
+private:
+    using Counters = std::unique_ptr<std::atomic<uint64_t>[]>;
+
+    class Chain;
+
+    void work(int worker, Options const & options, Counters & hits, Counters & squares);
+    bool done(Options const & options, Counters const & hits, Counters const & squares) const;
+
+    Constraints constraints_;
+    int cardCount_;
+    std::vector<int> unknown_;                      // Cards with more than one possible holder
+    std::vector<int> types_;                        // Type of each card, by card index
+    std::vector<std::vector<uint64_t>> clauses_;    // Sets of cards each player must hold at least one of, by player index
+    std::atomic<uint64_t> total_;                   // Samples added to the counters so far
+    std::atomic<bool> stop_;                        // Set when enough samples have been taken
+    uint64_t samples_;
+};
+
+#endif // !defined(DEALSAMPLER_H)
@@ -0,0 +1,192 @@
+#include "EventLog.h"
+
+#include "Bits.h"
+#include "Configuration.h"
+#include "EventParser.h"
+#include "GameEvent.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using json = nlohmann::json;
+
+static_assert(sizeof(EventRecord) == 32, "Event records are 32 bytes");
+
+namespace
+{
+// An event log starts with this header (see EventLog)
+struct EventLogHeader
+{
+    char     magic[4];      // "CLOG"
+    uint32_t byteOrder;     // EVENT_LOG_BYTE_ORDER as written
+    uint32_t version;       // EVENT_LOG_VERSION
+    uint8_t  players;       // Number of players, not including the answer
+    uint8_t  cards;
+    uint16_t reserved;
+};
+
+char const     EVENT_LOG_MAGIC[4]   = { 'C', 'L', 'O', 'G' };
+uint32_t const EVENT_LOG_VERSION    = 1;
+uint32_t const EVENT_LOG_BYTE_ORDER = 0x01020304;  // Detects logs written on machines with a different byte order
+
+void check(bool valid)
+{
+    if (!valid)
+        throw std::domain_error("Invalid event log");
+}
+
+template <typename T>
+void put(std::string & out, T const & value)
+{
+    out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+void putId(std::string & out, Solver::Id const & id)
+{
+    put(out, (uint16_t)id.size());
+    out += id;
+}
+
+// Returns the record of a valid event, given its players and cards as indexes. Throws std::domain_error if the event
+// does not fit in a record.
+EventRecord toRecord(GameEvent const & event, EventIndexes const & indexes)
+{
+    EventRecord record;
+    memset(&record, 0, sizeof(record));
+    record.kind = (uint8_t)event.kind;
+    if (event.kind == GameEvent::UNDO)
+    {
+        record.value = (uint32_t)event.count;
+        return record;
+    }
+
+    record.player    = (uint8_t)indexes.player;
+    record.cardCount = (uint8_t)indexes.cards.size();
+    if (event.kind == GameEvent::HAND)
+    {
+        for (int c : indexes.cards)
+        {
+            record.cards |= bit(c);
+        }
+        if (countBits(record.cards) != record.cardCount)
+            throw std::domain_error("Invalid hand");
+        return record;
+    }
+
+    if (indexes.cards.size() > EventRecord::MAX_CARDS)
+        throw std::domain_error("Too many cards for an event log");
+    if (indexes.showed.size() > EventRecord::MAX_SHOWED)
+        throw std::domain_error("Too many players for an event log");
+    for (size_t i = 0; i < indexes.cards.size(); ++i)
+    {
+        record.cards |= (uint64_t)indexes.cards[i] << (8 * i);
+    }
+    record.showedCount = (uint8_t)indexes.showed.size();
+    for (size_t i = 0; i < indexes.showed.size(); ++i)
+    {
+        record.showed[i] = (uint8_t)indexes.showed[i];
+    }
+    record.value = event.correct ? 1 : 0;
+    return record;
+}
+} // anonymous namespace
+
+EventLog::EventLog(void const * data, size_t size)
+{
+    char const * start = static_cast<char const *>(data);
+    check(matches(data, size));
+    EventLogHeader header;
+    memcpy(&header, start, sizeof(header));
+    check(header.byteOrder == EVENT_LOG_BYTE_ORDER && header.version == EVENT_LOG_VERSION);
+
+    size_t offset  = sizeof(header);
+    auto   readIds = [&] (Solver::IdList & ids, int count) {
+        for (int i = 0; i < count; ++i)
+        {
+            uint16_t length;
+            check(offset + sizeof(length) <= size);
+            memcpy(&length, start + offset, sizeof(length));
+            offset += sizeof(length);
+            check(offset + length <= size);
+            ids.emplace_back(start + offset, length);
+            offset += length;
+        }
+    };
+    readIds(players_, header.players);
+    readIds(cards_, header.cards);
+
+    // The records start at a multiple of 8 bytes, so that they can be read in place
+    offset = (offset + 7) & ~size_t(7);
+    check(offset <= size && (size - offset) % sizeof(EventRecord) == 0);
+    check(reinterpret_cast<uintptr_t>(start) % alignof(EventRecord) == 0);
+    records_ = reinterpret_cast<EventRecord const *>(start + offset);
+    size_    = (size - offset) / sizeof(EventRecord);
+}
+
+bool EventLog::matches(void const * data, size_t size)
+{
+    return size >= sizeof(EventLogHeader) && memcmp(data, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) == 0;
+}
+
+int EventLog::convert(Configuration const & configuration, std::istream & in, std::ostream & out, std::ostream & errors)
+{
+    std::string input;
+    std::getline(in, input);
+    Solver::IdList players = json::parse(input);
+    Solver         solver(configuration.solverRules(), players);
+
+    EventLogHeader header;
+    memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+    header.byteOrder = EVENT_LOG_BYTE_ORDER;
+    header.version   = EVENT_LOG_VERSION;
+    header.players   = (uint8_t)players.size();
+    header.cards     = (uint8_t)solver.cardCount();
+    header.reserved  = 0;
+
+    std::string log;
+    put(log, header);
+    for (auto const & p : players)
+    {
+        putId(log, p);
+    }
+    for (int c = 0; c < solver.cardCount(); ++c)
+    {
+        putId(log, solver.cardId(c));
+    }
+    log.resize((log.size() + 7) & ~size_t(7), '\0');
+
+    int          events = 0;
+    EventParser  parser(in, solver, 2);
+    GameEvent    event;
+    EventIndexes indexes;
+    while (true)
+    {
+        std::string error;
+        try
+        {
+            if (!parser.next(event, indexes))
+                break;
+            try
+            {
+                put(log, toRecord(event, indexes));
+                ++events;
+                continue;
+            }
+            catch (std::exception const & e)
+            {
+                error = "line " + std::to_string(parser.line()) + ": " + e.what();
+            }
+        }
+        catch (std::exception const & e)
+        {
+            error = e.what();
+        }
+        errors << error << ": '" << parser.text() << "'" << std::endl;
+    }
+    out.write(log.data(), (std::streamsize)log.size());
+    return events;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#if !defined(EVENTLOG_H)
+#define EVENTLOG_H 1
+
+#include "Solver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+struct Configuration;
+
+//! An event in a binary event log. Players and cards are given by their indexes in the solver (see
+//! Solver::playerIndex() and Solver::cardIndex()).
+struct EventRecord
+{
+    uint8_t kind;               //!< A GameEvent::Kind
+    uint8_t player;             //!< Player the event is about
+    uint8_t cardCount;          //!< Number of cards
+    uint8_t showedCount;        //!< Number of players that responded to a suggestion
+    uint32_t value;             //!< Number of events to undo, or 1 if an accusation is correct
+    uint64_t cards;             //!< Cards in a hand as a mask, or else the cards in order, one per byte from the lowest
+    uint8_t showed[16];         //!< Players that responded to a suggestion, in order
+
+    static int const MAX_CARDS  = 8;    //!< Most cards in a suggestion or accusation
+    static int const MAX_SHOWED = 16;   //!< Most players that can respond to a suggestion
+};
+
+//! A game in the compact binary form of its events, read directly from memory (such as a MappedFile).
+//!
+//! The log starts with a header, followed by the player IDs in turn order and the card IDs in order of index, each a
+//! 16-bit length followed by the characters. Then, starting at a multiple of 8 bytes, come the events as fixed-size
+//! records. Everything is in the byte order of the machine that wrote the log. The card IDs tie the indexes in the
+//! records to the deck, so a log can only be replayed with the same deck.
+class EventLog
+{
+public:
+    //! Constructor. Reads the header and the IDs. Throws std::domain_error if the data is not a valid event log.
+    EventLog(void const * data, size_t size);
+
+    //! Returns true if the data starts like an event log
+    static bool matches(void const * data, size_t size);
+
+    //! Converts a game from its JSON form (the players, and then one event per line) to a binary log. Invalid events
+    //! are reported to the error stream and left out. Returns the number of events written.
+    static int convert(Configuration const & configuration, std::istream & in, std::ostream & out, std::ostream & errors);
+
+    //! Returns the players in turn order
+    Solver::IdList const & players() const { return players_; }
+
+    //! Returns the IDs of the cards by index
+    Solver::IdList const & cards() const { return cards_; }
+
+    //! Returns the number of events
+    size_t size() const { return size_; }
+
+    //! Returns an event
+    EventRecord const & operator[](size_t i) const { return records_[i]; }
+
+private:
+    Solver::IdList players_;
+    Solver::IdList cards_;
+    EventRecord const * records_;
+    size_t size_;
+};
+
+#endif // !defined(EVENTLOG_H)
@@ -0,0 +1,528 @@
+#include "EventParser.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+size_t const BLOCK_SIZE = 64 * 1024;    // Input is read in blocks of this size
+int const    MAX_DEPTH  = 64;           // Deepest nesting of the values that are skipped
+
+// The kinds of events, by the name of their element, in order of precedence if an event has more than one
+int const             NUMBER_OF_KINDS = 5;
+char const * const    KIND_NAMES[NUMBER_OF_KINDS] = { "show", "suggest", "hand", "accuse", "undo" };
+GameEvent::Kind const KINDS[NUMBER_OF_KINDS]      = {
+    GameEvent::SHOW, GameEvent::SUGGEST, GameEvent::HAND, GameEvent::ACCUSE, GameEvent::UNDO
+};
+
+// The elements of an event
+enum Field
+{
+    PLAYER,
+    CARD,
+    CARDS,
+    SHOWED,
+    CORRECT,
+    NUMBER_OF_FIELDS
+};
+char const * const FIELD_NAMES[NUMBER_OF_FIELDS] = { "player", "card", "cards", "showed", "correct" };
+
+void appendUtf8(std::string & s, uint32_t c)
+{
+    if (c < 0x80)
+    {
+        s += (char)c;
+    }
+    else if (c < 0x800)
+    {
+        s += (char)(0xc0 | (c >> 6));
+        s += (char)(0x80 | (c & 0x3f));
+    }
+    else if (c < 0x10000)
+    {
+        s += (char)(0xe0 | (c >> 12));
+        s += (char)(0x80 | ((c >> 6) & 0x3f));
+        s += (char)(0x80 | (c & 0x3f));
+    }
+    else
+    {
+        s += (char)(0xf0 | (c >> 18));
+        s += (char)(0x80 | ((c >> 12) & 0x3f));
+        s += (char)(0x80 | ((c >> 6) & 0x3f));
+        s += (char)(0x80 | (c & 0x3f));
+    }
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+} // anonymous namespace
+
+EventParser::EventParser(std::istream & in, Solver const & solver, int firstLine /*= 1*/)
+    : in_(in)
+    , solver_(solver)
+    , buffer_(BLOCK_SIZE)
+    , start_(0)
+    , end_(0)
+    , eof_(false)
+    , line_(firstLine - 1)
+    , lineBegin_(nullptr)
+    , lineEnd_(nullptr)
+    , p_(nullptr)
+    , limit_(nullptr)
+{
+}
+
+bool EventParser::next(GameEvent & event, EventIndexes & indexes)
+{
+    if (!readLine())
+        return false;
+    parseEvent(event, indexes);
+    return true;
+}
+
+// Finds the next complete line, reading more of the input as needed. Returns false if there are no more.
+bool EventParser::readLine()
+{
+    while (true)
+    {
+        char const * begin   = buffer_.data() + start_;
+        char const * newline = static_cast<char const *>(memchr(begin, '\n', end_ - start_));
+        if (newline)
+        {
+            ++line_;
+            lineBegin_ = begin;
+            lineEnd_   = newline;
+            start_     = newline + 1 - buffer_.data();
+            return true;
+        }
+        if (eof_)
+            return false;
+
+        // Move the partial line to the start of the buffer, making the buffer bigger if the line fills it, and read
+        // more after it
+        memmove(buffer_.data(), begin, end_ - start_);
+        end_  -= start_;
+        start_ = 0;
+        if (end_ == buffer_.size())
+            buffer_.resize(buffer_.size() * 2);
+        in_.read(buffer_.data() + end_, (std::streamsize)(buffer_.size() - end_));
+        size_t count = (size_t)in_.gcount();
+        end_ += count;
+        eof_  = (count == 0);
+    }
+}
+
+void EventParser::parseEvent(GameEvent & event, EventIndexes & indexes)
+{
+    p_     = lineBegin_;
+    limit_ = lineEnd_;
+    Span kinds[NUMBER_OF_KINDS];
+    readObject(KIND_NAMES, kinds, NUMBER_OF_KINDS);
+    skipSpace();
+    if (p_ != limit_)
+        fail("Unexpected text after the event");
+
+    int k = 0;
+    while (k < NUMBER_OF_KINDS && !kinds[k].begin)
+    {
+        ++k;
+    }
+    if (k == NUMBER_OF_KINDS)
+        fail("Invalid event type");
+
+    event.kind    = KINDS[k];
+    event.correct = false;
+    event.count   = 0;
+    indexes.cards.clear();
+    indexes.showed.clear();
+    if (event.kind == GameEvent::UNDO)
+    {
+        event.count = readCount(kinds[k]);
+        event.player.clear();
+        event.cards.clear();
+        event.showed.clear();
+        return;
+    }
+
+    p_     = kinds[k].begin;
+    limit_ = kinds[k].end;
+    Span fields[NUMBER_OF_FIELDS];
+    readObject(FIELD_NAMES, fields, NUMBER_OF_FIELDS);
+    indexes.player = readPlayer(fields[PLAYER], "Invalid player");
+    switch (event.kind)
+    {
+        case GameEvent::SHOW:
+            indexes.cards.push_back(readCard(fields[CARD], "Invalid card"));
+            break;
+        case GameEvent::SUGGEST:
+            readList(fields[CARDS], &Solver::findCard, indexes.cards, "Invalid cards");
+            readList(fields[SHOWED], &Solver::findPlayer, indexes.showed, "Invalid players");
+            break;
+        case GameEvent::HAND:
+            readList(fields[CARDS], &Solver::findCard, indexes.cards, "Invalid hand");
+            break;
+        case GameEvent::ACCUSE:
+            readList(fields[CARDS], &Solver::findCard, indexes.cards, "Invalid cards");
+            event.correct = readBool(fields[CORRECT], "Invalid outcome");
+            break;
+        case GameEvent::UNDO:
+            break;
+    }
+
+    // The IDs are the solver's own, so that they are the same however they were written in the input
+    event.player = solver_.playerId(indexes.player);
+    event.cards.resize(indexes.cards.size());
+    for (size_t i = 0; i < indexes.cards.size(); ++i)
+    {
+        event.cards[i] = solver_.cardId(indexes.cards[i]);
+    }
+    event.showed.resize(indexes.showed.size());
+    for (size_t i = 0; i < indexes.showed.size(); ++i)
+    {
+        event.showed[i] = solver_.playerId(indexes.showed[i]);
+    }
+}
+
+void EventParser::skipSpace()
+{
+    while (p_ < limit_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n'))
+    {
+        ++p_;
+    }
+}
+
+void EventParser::expect(char c)
+{
+    if (peek() != c)
+        fail(std::string("Expected '") + c + "'");
+    ++p_;
+}
+
+// Reads an object, noting where the value of each of the named elements is. Other elements are skipped.
+void EventParser::readObject(char const * const * names, Span * spans, int count)
+{
+    skipSpace();
+    expect('{');
+    skipSpace();
+    if (peek() == '}')
+    {
+        ++p_;
+        return;
+    }
+    while (true)
+    {
+        skipSpace();
+        // The name is matched before the value is read, since reading the value may replace it
+        std::string_view name;
+        if (!readString(name))
+            fail("Expected a name");
+        int i = 0;
+        while (i < count && name != names[i])
+        {
+            ++i;
+        }
+        skipSpace();
+        expect(':');
+        skipSpace();
+        char const * begin = p_;
+        skipValue(0);
+        if (i < count)
+            spans[i] = { begin, p_ };
+        skipSpace();
+        if (peek() != ',')
+            break;
+        ++p_;
+    }
+    expect('}');
+}
+
+// Skips a value, checking only that it is valid JSON
+void EventParser::skipValue(int depth)
+{
+    if (depth > MAX_DEPTH)
+        fail("Too deeply nested");
+
+    std::string_view text;
+    switch (peek())
+    {
+        case '"':
+            readString(text);
+            return;
+
+        case '{':
+        case '[':
+        {
+            char close = (*p_ == '{') ? '}' : ']';
+            ++p_;
+            skipSpace();
+            if (peek() == close)
+            {
+                ++p_;
+                return;
+            }
+            while (true)
+            {
+                skipSpace();
+                if (close == '}')
+                {
+                    if (!readString(text))
+                        fail("Expected a name");
+                    skipSpace();
+                    expect(':');
+                    skipSpace();
+                }
+                skipValue(depth + 1);
+                skipSpace();
+                if (peek() != ',')
+                    break;
+                ++p_;
+            }
+            expect(close);
+            return;
+        }
+
+        case 't':
+        case 'f':
+        case 'n':
+        {
+            char const * literal = (*p_ == 't') ? "true" : (*p_ == 'f') ? "false" : "null";
+            size_t       length  = strlen(literal);
+            if ((size_t)(limit_ - p_) < length || memcmp(p_, literal, length) != 0)
+                fail("Invalid value");
+            p_ += length;
+            return;
+        }
+
+        default:
+        {
+            // A number
+            if (peek() == '-')
+                ++p_;
+            if (!isDigit(peek()))
+                fail("Invalid value");
+            if (*p_ == '0')
+            {
+                ++p_;
+            }
+            else
+            {
+                while (isDigit(peek()))
+                {
+                    ++p_;
+                }
+            }
+            if (peek() == '.')
+            {
+                ++p_;
+                if (!isDigit(peek()))
+                    fail("Invalid number");
+                while (isDigit(peek()))
+                {
+                    ++p_;
+                }
+            }
+            if (peek() == 'e' || peek() == 'E')
+            {
+                ++p_;
+                if (peek() == '+' || peek() == '-')
+                    ++p_;
+                if (!isDigit(peek()))
+                    fail("Invalid number");
+                while (isDigit(peek()))
+                {
+                    ++p_;
+                }
+            }
+            return;
+        }
+    }
+}
+
+// Reads a string. Returns false if the next value is not a string. The value is valid until the next string is read.
+bool EventParser::readString(std::string_view & value)
+{
+    if (peek() != '"')
+        return false;
+
+    // Most strings have no escapes, so they are used in place
+    char const * begin = ++p_;
+    while (p_ < limit_ && *p_ != '"' && *p_ != '\\')
+    {
+        if ((unsigned char)*p_ < 0x20)
+            fail("Invalid string");
+        ++p_;
+    }
+    if (p_ == limit_)
+        fail("Unterminated string");
+    if (*p_ == '"')
+    {
+        value = std::string_view(begin, p_ - begin);
+        ++p_;
+        return true;
+    }
+
+    auto readHex = [this] () {
+        if (limit_ - p_ < 4)
+            fail("Invalid escape");
+        uint32_t code = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *p_++;
+            int  digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
+            else
+                fail("Invalid escape");
+            code = code * 16 + digit;
+        }
+        return code;
+    };
+
+    unescaped_.assign(begin, p_);
+    while (true)
+    {
+        if (p_ == limit_)
+            fail("Unterminated string");
+        char c = *p_++;
+        if (c == '"')
+            break;
+        if ((unsigned char)c < 0x20)
+            fail("Invalid string");
+        if (c != '\\')
+        {
+            unescaped_ += c;
+            continue;
+        }
+        if (p_ == limit_)
+            fail("Unterminated string");
+        switch (*p_++)
+        {
+            case '"':  unescaped_ += '"';  break;
+            case '\\': unescaped_ += '\\'; break;
+            case '/':  unescaped_ += '/';  break;
+            case 'b':  unescaped_ += '\b'; break;
+            case 'f':  unescaped_ += '\f'; break;
+            case 'n':  unescaped_ += '\n'; break;
+            case 'r':  unescaped_ += '\r'; break;
+            case 't':  unescaped_ += '\t'; break;
+            case 'u':
+            {
+                // A character outside the basic plane is escaped as a pair of surrogates
+                uint32_t code = readHex();
+                if (code >= 0xd800 && code < 0xdc00)
+                {
+                    if (limit_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+                        fail("Invalid escape");
+                    p_ += 2;
+                    uint32_t low = readHex();
+                    if (low < 0xdc00 || low >= 0xe000)
+                        fail("Invalid escape");
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                else if (code >= 0xdc00 && code < 0xe000)
+                {
+                    fail("Invalid escape");
+                }
+                appendUtf8(unescaped_, code);
+                break;
+            }
+            default:
+                fail("Invalid escape");
+        }
+    }
+    value = unescaped_;
+    return true;
+}
+
+int EventParser::readPlayer(Span span, char const * error)
+{
+    std::string_view id;
+    p_     = span.begin;
+    limit_ = span.end;
+    if (!span.begin || !readString(id))
+        fail(error);
+    int p = solver_.findPlayer(id);
+    if (p < 0)
+        fail(error);
+    return p;
+}
+
+int EventParser::readCard(Span span, char const * error)
+{
+    std::string_view id;
+    p_     = span.begin;
+    limit_ = span.end;
+    if (!span.begin || !readString(id))
+        fail(error);
+    int c = solver_.findCard(id);
+    if (c < 0)
+        fail(error);
+    return c;
+}
+
+// Reads a list of IDs, appending their indexes
+void EventParser::readList(Span span, Finder find, std::vector<int> & indexes, char const * error)
+{
+    p_     = span.begin;
+    limit_ = span.end;
+    if (!span.begin || peek() != '[')
+        fail(error);
+    ++p_;
+    skipSpace();
+    if (peek() == ']')
+        return;
+    while (true)
+    {
+        skipSpace();
+        std::string_view id;
+        if (!readString(id))
+            fail(error);
+        int i = (solver_.*find)(id);
+        if (i < 0)
+            fail(error);
+        indexes.push_back(i);
+        skipSpace();
+        if (peek() != ',')
+            break;
+        ++p_;
+    }
+}
+
+bool EventParser::readBool(Span span, char const * error)
+{
+    std::string_view text(span.begin ? span.begin : "", span.end - span.begin);
+    if (text == "true")
+        return true;
+    if (text != "false")
+        fail(error);
+    return false;
+}
+
+// Reads the number of events to undo, which must be a positive integer
+int EventParser::readCount(Span span)
+{
+    p_     = span.begin;
+    limit_ = span.end;
+    long long count = 0;
+    while (isDigit(peek()) && count <= INT32_MAX)
+    {
+        count = count * 10 + (*p_++ - '0');
+    }
+    if (p_ != limit_ || count < 1 || count > INT32_MAX)
+        fail("Invalid count");
+    return (int)count;
+}
+
+void EventParser::fail(std::string const & message) const
+{
+    throw std::domain_error("line " + std::to_string(line_) + ": " + message);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#if !defined(EVENTPARSER_H)
+#define EVENTPARSER_H 1
+
+#include "GameEvent.h"
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! An event's player and cards as indexes (see Solver::playerIndex() and Solver::cardIndex())
+struct EventIndexes
+{
+    int player = -1;            //!< Player the event is about (not set for an undo)
+    std::vector<int> cards;     //!< Cards in the hand, suggestion, or accusation, or the card shown
+    std::vector<int> showed;    //!< Players that responded to a suggestion
+};
+
+//! Reads events in their JSON form (see GameEvent::fromJson), one per line, straight from a stream.
+//!
+//! The input is read in large blocks, and each line is tokenized in place without building a JSON document. Only the
+//! elements of the event schema are decoded; anything else is skipped. Player and card IDs are looked up in the solver's
+//! symbol tables as they are read, so the event is produced as indexes as well as IDs. The lists given to next() are
+//! reused from one event to the next, so once they have grown, reading an event allocates nothing.
+class EventParser
+{
+public:
+    //! Constructor. The solver is used only for its players and cards, so it can be a copy, but it must outlive the
+    //! parser. Lines are numbered from firstLine.
+    EventParser(std::istream & in, Solver const & solver, int firstLine = 1);
+
+    //! Reads the next event, with its players and cards as indexes. Returns false if there are no more events. A line
+    //! that does not end with a newline is ignored. Throws std::domain_error, naming the line, if the event is not
+    //! valid. The next call reads the line after it.
+    bool next(GameEvent & event, EventIndexes & indexes);
+
+    //! Returns the number of the line read most recently
+    int line() const { return line_; }
+
+    //! Returns the text of the line read most recently. It is valid until the next call to next().
+    std::string_view text() const { return std::string_view(lineBegin_, lineEnd_ - lineBegin_); }
+
+private:
+    // The location of an element's value in the line, or null if the element is missing
+    struct Span
+    {
+        char const * begin = nullptr;
+        char const * end   = nullptr;
+    };
+
+    using Finder = int (Solver::*)(std::string_view id) const;    // Looks up a player or card ID
+
+    bool readLine();
+    void parseEvent(GameEvent & event, EventIndexes & indexes);
+
+    char peek() const { return (p_ < limit_) ? *p_ : '\0'; }
+    void skipSpace();
+    void expect(char c);
+    void readObject(char const * const * names, Span * spans, int count);
+    void skipValue(int depth);
+    bool readString(std::string_view & value);
+    int  readPlayer(Span span, char const * error);
+    int  readCard(Span span, char const * error);
+    void readList(Span span, Finder find, std::vector<int> & indexes, char const * error);
+    bool readBool(Span span, char const * error);
+    int  readCount(Span span);
+    [[noreturn]] void fail(std::string const & message) const;
+
+    std::istream & in_;
+    Solver const & solver_;
+    std::vector<char> buffer_;
+    size_t start_;                  // Start of the unread input in the buffer
+    size_t end_;                    // End of the input in the buffer
+    bool eof_;
+    int line_;
+    char const * lineBegin_;
+    char const * lineEnd_;
+    char const * p_;                // Next character to be tokenized
+    char const * limit_;            // End of the text being tokenized
+    std::string unescaped_;         // A string containing escapes, with the escapes replaced
+};
+
+#endif // !defined(EVENTPARSER_H)
@@ -0,0 +1,479 @@
+#include "ExactCounter.h"
+
+#include "Bits.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <tuple>
+
+namespace
+{
+// Returns n choose k
+double binomial(int n, int k)
+{
+    static std::vector<std::vector<double>> const table = [] {
+        std::vector<std::vector<double>> t(65, std::vector<double>(65, 0.0));
+        for (int i = 0; i <= 64; ++i)
+        {
+            t[i][0] = 1.0;
+            for (int j = 1; j <= i; ++j)
+            {
+                t[i][j] = t[i - 1][j - 1] + (j < i ? t[i - 1][j] : 0.0);
+            }
+        }
+        return t;
+    }();
+    return table[n][k];
+}
+} // anonymous namespace
+
+ExactCounter::ExactCounter(Constraints const & constraints)
+    : constraints_(constraints)
+    , feasible_(true)
+    , known_(0)
+    , full_(0)
+{
+    int        n        = constraints_.playerCount();
+    int        answer   = constraints_.answer;
+    auto &     possible = constraints_.possible;
+    uint64_t   allCards = 0;
+    for (auto t : constraints_.types)
+    {
+        allCards |= t;
+    }
+
+    // Find the cards whose holder is known. Since the answer holds only one of each type, its known cards rule out the
+    // others of the same type, which may reveal more holders.
+    std::vector<uint64_t> held(n, 0);
+    bool                  changed = true;
+    while (changed && feasible_)
+    {
+        changed = false;
+        std::fill(held.begin(), held.end(), 0);
+        known_ = 0;
+        forEachBit(allCards, [&] (int c) {
+            int holders = 0;
+            int holder  = -1;
+            for (int p = 0; p < n; ++p)
+            {
+                if (possible[p] & bit(c))
+                {
+                    ++holders;
+                    holder = p;
+                }
+            }
+            if (holders == 0)
+            {
+                feasible_ = false;
+            }
+            else if (holders == 1)
+            {
+                held[holder] |= bit(c);
+                known_       |= bit(c);
+            }
+        });
+
+        for (auto t : constraints_.types)
+        {
+            uint64_t answerHeld = held[answer] & t;
+            if (countBits(answerHeld) > 1)
+                feasible_ = false;
+            else if (answerHeld && (possible[answer] & t & ~answerHeld))
+            {
+                possible[answer] &= ~(t & ~answerHeld);
+                changed           = true;
+            }
+        }
+    }
+    if (!feasible_)
+        return;
+
+    uint64_t unknown = allCards & ~known_;
+
+    // Limits on the number of unknown cards each player holds
+    minCards_.resize(n);
+    maxCards_.resize(n);
+    for (int p = 0; p < n; ++p)
+    {
+        minCards_[p] = std::max(0, constraints_.minCards[p] - countBits(held[p]));
+        maxCards_[p] = constraints_.maxCards[p] - countBits(held[p]);
+        if (p != answer && maxCards_[p] < 0)
+            feasible_ = false;
+    }
+
+    // Reduce the clauses to the unknown cards, dropping the ones that are already satisfied
+    std::vector<Constraints::HoldsOneOf> holdsOneOf;
+    for (auto const & h : constraints_.holdsOneOf)
+    {
+        if (h.cards & held[h.player])
+            continue;
+        uint64_t cards = h.cards & unknown & possible[h.player];
+        if (cards == 0)
+            feasible_ = false;
+        holdsOneOf.push_back({ h.player, cards });
+    }
+
+    std::vector<uint64_t> answerNotAll;
+    for (auto cards : constraints_.answerNotAll)
+    {
+        if (cards & ~possible[answer])
+            continue;   // The answer is known to not hold one of them
+        bool sameType = false;
+        for (auto t : constraints_.types)
+        {
+            sameType = sameType || countBits(cards & t) > 1;
+        }
+        if (sameType)
+            continue;   // The answer can't hold all of them anyway
+        if ((cards & unknown) == 0)
+            feasible_ = false;
+        answerNotAll.push_back(cards & unknown);
+    }
+    if (!feasible_)
+        return;
+
+    // Group the unknown cards into classes of indistinguishable cards
+    {
+        using Signature = std::tuple<uint64_t, int, std::vector<int>>;
+        std::map<Signature, int> signatures;
+        forEachBit(unknown, [&] (int c) {
+            uint64_t holders = 0;
+            for (int p = 0; p < n; ++p)
+            {
+                if (possible[p] & bit(c))
+                    holders |= bit(p);
+            }
+            int type = -1;
+            if (holders & bit(answer))
+            {
+                for (size_t t = 0; t < constraints_.types.size(); ++t)
+                {
+                    if (constraints_.types[t] & bit(c))
+                        type = (int)t;
+                }
+            }
+            std::vector<int> clauses;
+            for (size_t i = 0; i < holdsOneOf.size(); ++i)
+            {
+                if (holdsOneOf[i].cards & bit(c))
+                    clauses.push_back((int)i);
+            }
+            for (size_t i = 0; i < answerNotAll.size(); ++i)
+            {
+                if (answerNotAll[i] & bit(c))
+                    clauses.push_back((int)(holdsOneOf.size() + i));
+            }
+
+            Signature signature(holders, type, clauses);
+            auto      s = signatures.find(signature);
+            if (s == signatures.end())
+            {
+                signatures[signature] = (int)classes_.size();
+                classes_.push_back({ bit(c), 1, 0 });
+            }
+            else
+            {
+                classes_[s->second].cards |= bit(c);
+                ++classes_[s->second].size;
+            }
+        });
+    }
+
+    // A state is the number of remaining cards in each class, in mixed radix
+    uint64_t stride = 1;
+    for (auto & c : classes_)
+    {
+        c.stride = stride;
+        full_   += c.size * stride;
+        assert(stride <= UINT64_MAX / (c.size + 1));
+        stride  *= c.size + 1;
+    }
+
+    // Returns the set of classes containing any of the cards
+    auto classesOf = [this] (uint64_t cards) {
+        uint64_t m = 0;
+        for (size_t i = 0; i < classes_.size(); ++i)
+        {
+            if (classes_[i].cards & cards)
+                m |= bit((int)i);
+        }
+        return m;
+    };
+
+    holders_.resize(n);
+    clauses_.resize(n);
+    for (int p = 0; p < n; ++p)
+    {
+        holders_[p] = classesOf(possible[p] & unknown);
+    }
+    for (auto const & h : holdsOneOf)
+    {
+        clauses_[h.player].push_back(classesOf(h.cards));
+    }
+    for (auto cards : answerNotAll)
+    {
+        answerNotAll_.push_back(classesOf(cards));
+    }
+
+    // The answer chooses one card of each type that it is not already known to hold
+    for (auto t : constraints_.types)
+    {
+        if (held[answer] & t)
+        {
+            answerChoices_.push_back(0);
+        }
+        else
+        {
+            uint64_t choices = classesOf(t & possible[answer] & unknown);
+            if (choices == 0)
+                feasible_ = false;
+            answerChoices_.push_back(choices);
+        }
+    }
+
+    // Deal to the most constrained players first
+    for (int p = 0; p < n; ++p)
+    {
+        if (p != answer)
+            order_.push_back(p);
+    }
+    std::stable_sort(order_.begin(), order_.end(), [&] (int a, int b) {
+        return countBits(possible[a] & unknown) < countBits(possible[b] & unknown);
+    });
+
+    int levels = (int)order_.size();
+    holdableAfter_.assign(levels + 1, 0);
+    minAfter_.assign(levels + 1, 0);
+    maxAfter_.assign(levels + 1, 0);
+    for (int i = levels - 1; i >= 0; --i)
+    {
+        holdableAfter_[i] = holdableAfter_[i + 1];
+        minAfter_[i]      = minAfter_[i + 1];
+        maxAfter_[i]      = maxAfter_[i + 1];
+        if (i + 1 < levels)
+        {
+            int next = order_[i + 1];
+            holdableAfter_[i] |= holders_[next];
+            minAfter_[i]      += minCards_[next];
+            maxAfter_[i]      += maxCards_[next];
+        }
+    }
+    memo_.resize(levels + 1);
+}
+
+double ExactCounter::count()
+{
+    if (!feasible_)
+        return 0.0;
+
+    double total = 0.0;
+    forEachAnswer([&] (uint64_t state, double weight, uint64_t) {
+        total += weight * ways(0, state);
+    });
+    return total;
+}
+
+std::vector<std::vector<double>> ExactCounter::probabilities()
+{
+    int n         = constraints_.playerCount();
+    int cardCount = 0;
+    for (auto t : constraints_.types)
+    {
+        cardCount += countBits(t);
+    }
+    std::vector<std::vector<double>> result(n, std::vector<double>(cardCount, 0.0));
+    if (!feasible_)
+        return result;
+
+    int                              levels = (int)order_.size();
+    std::vector<Memo>                reached(levels + 1);   // Number of ways to reach each state, by level
+    std::vector<std::vector<double>> expected(n, std::vector<double>(classes_.size(), 0.0));
+    double                           total = 0.0;
+
+    // Weigh each choice by the number of ways to reach it times the number of ways to deal the rest. The expected number
+    // of cards of a class held by a player, divided by the size of the class, is the probability of holding each card.
+    forEachAnswer([&] (uint64_t state, double weight, uint64_t chosen) {
+        double rest = ways(0, state);
+        if (rest > 0.0)
+        {
+            total += weight * rest;
+            forEachBit(chosen, [&] (int c) {
+                expected[constraints_.answer][c] += weight * rest;
+            });
+            reached[0][state] += weight;
+        }
+    });
+    if (total == 0.0)
+        return result;
+
+    for (int level = 0; level < levels; ++level)
+    {
+        int p = order_[level];
+        for (auto const & r : reached[level])
+        {
+            forEachChoice(level, r.first, [&] (uint64_t next, double weight, uint64_t chosen, int const * counts) {
+                double rest = ways(level + 1, next);
+                if (rest > 0.0)
+                {
+                    double w = r.second * weight;
+                    forEachBit(chosen, [&] (int c) {
+                        expected[p][c] += w * rest * counts[c];
+                    });
+                    reached[level + 1][next] += w;
+                }
+            });
+        }
+        reached[level].clear();
+    }
+
+    for (int p = 0; p < n; ++p)
+    {
+        forEachBit(known_ & constraints_.possible[p], [&] (int c) {
+            result[p][c] = 1.0;
+        });
+        for (size_t i = 0; i < classes_.size(); ++i)
+        {
+            double probability = expected[p][i] / (total * classes_[i].size);
+            forEachBit(classes_[i].cards, [&] (int c) {
+                result[p][c] = probability;
+            });
+        }
+    }
+    return result;
+}
+
+// Calls f(next, weight, chosen, counts) for each way the player at this level can take cards from the remaining cards,
+// where next is the resulting state, weight is the number of ways to pick the specific cards, chosen is the set of
+// classes the player takes cards from, and counts is the number of cards taken from each class.
+template <typename F>
+void ExactCounter::forEachChoice(int level, uint64_t state, F f) const
+{
+    int      p       = order_[level];
+    uint64_t holders = holders_[p];
+    uint64_t later   = holdableAfter_[level];
+    int      total   = 0;
+    int      forced  = 0;
+    uint64_t options = 0;
+    int      counts[64];
+    int      available[64];
+
+    uint64_t chosen  = 0;
+    uint64_t next    = state;
+
+    for (int c = 0; c < (int)classes_.size(); ++c)
+    {
+        int r = remaining(state, c);
+        if (r == 0)
+            continue;
+        total += r;
+        if (holders & bit(c))
+        {
+            available[c] = r;
+            if (later & bit(c))
+            {
+                options |= bit(c);
+            }
+            else
+            {
+                // Nobody after this player can hold these cards, so the player must take them all
+                forced    += r;
+                counts[c]  = r;
+                chosen    |= bit(c);
+                next      -= r * classes_[c].stride;
+            }
+        }
+        else if (!(later & bit(c)))
+        {
+            return;     // Nobody left can hold these cards
+        }
+    }
+
+    int lo = minCards_[p];
+    int hi = maxCards_[p];
+    if (forced > hi)
+        return;
+
+    std::vector<int> optionList;
+    forEachBit(options, [&] (int c) { optionList.push_back(c); });
+
+    // Enumerate the number of cards taken from each optional class
+    auto recurse = [&] (auto & self, size_t i, int taken, uint64_t chosen, uint64_t next, double weight) -> void {
+        if (i == optionList.size())
+        {
+            if (taken < lo)
+                return;
+            int left = total - taken;
+            if (left < minAfter_[level] || left > maxAfter_[level])
+                return;
+            for (auto clause : clauses_[p])
+            {
+                if ((chosen & clause) == 0)
+                    return;
+            }
+            f(next, weight, chosen, counts);
+            return;
+        }
+
+        int c   = optionList[i];
+        int max = std::min(available[c], hi - taken);
+        for (int k = 0; k <= max; ++k)
+        {
+            counts[c] = k;
+            self(self,
+                 i + 1,
+                 taken + k,
+                 k > 0 ? (chosen | bit(c)) : chosen,
+                 next - k * classes_[c].stride,
+                 weight * binomial(available[c], k));
+        }
+        counts[c] = 0;
+    };
+    recurse(recurse, 0, forced, chosen, next, 1.0);
+}
+
+// Calls f(state, weight, chosen) for each way the answer can choose one card of each type, where state is the resulting
+// state, weight is the number of ways to pick the specific cards, and chosen is the set of classes chosen from.
+template <typename F>
+void ExactCounter::forEachAnswer(F f) const
+{
+    auto recurse = [&] (auto & self, size_t t, uint64_t state, double weight, uint64_t chosen) -> void {
+        if (t == answerChoices_.size())
+        {
+            for (auto clause : answerNotAll_)
+            {
+                if ((chosen & clause) == clause)
+                    return;
+            }
+            f(state, weight, chosen);
+            return;
+        }
+        if (answerChoices_[t] == 0)
+        {
+            self(self, t + 1, state, weight, chosen);
+            return;
+        }
+        forEachBit(answerChoices_[t], [&] (int c) {
+            self(self, t + 1, state - classes_[c].stride, weight * classes_[c].size, chosen | bit(c));
+        });
+    };
+    recurse(recurse, 0, full_, 1.0, 0);
+}
+
+// Returns the number of ways to deal the remaining cards to the players at and after this level
+double ExactCounter::ways(int level, uint64_t state)
+{
+    if (level == (int)order_.size())
+        return state == 0 ? 1.0 : 0.0;
+
+    auto m = memo_[level].find(state);
+    if (m != memo_[level].end())
+        return m->second;
+
+    double total = 0.0;
+    forEachChoice(level, state, [&] (uint64_t next, double weight, uint64_t, int const *) {
+        total += weight * ways(level + 1, next);
+    });
+    memo_[level][state] = total;
+    return total;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#if !defined(EXACTCOUNTER_H)
+#define EXACTCOUNTER_H 1
+
+#include "Constraints.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//! Computes the exact probability of every player holding every card by counting all deals consistent with the constraints.
+//!
+//! Cards that are indistinguishable under the constraints (same possible holders, same clauses, and the same type if the
+//! answer might hold them) are grouped into classes, and the deals are counted by dynamic programming over the players
+//! where the state is the number of cards of each class that remain to be dealt. Subproblems are memoised, so players
+//! that reach the same state by different choices share the work.
+class ExactCounter
+{
+public:
+    //! Constructor
+    explicit ExactCounter(Constraints const & constraints);
+
+    //! Returns the number of consistent deals
+    double count();
+
+    //! Returns an upper bound on the number of states the counter may visit for each player, which is a rough measure of
+    //! how expensive counting is
+    double complexity() const { return (double)full_ + 1.0; }
+
+    //! Returns the probability of each player holding each card, by player index and card index. All probabilities are
+    //! 0 if there is no consistent deal.
+    std::vector<std::vector<double>> probabilities();
+
+private:
+    struct Class
+    {
+        uint64_t cards;         // Cards in the class
+        int size;               // Number of cards in the class
+        uint64_t stride;        // Multiplier of the class's count in a state
+    };
+
+    using Memo = std::unordered_map<uint64_t, double>;
+
+    template <typename F>
+    void forEachChoice(int level, uint64_t state, F f) const;
+    template <typename F>
+    void forEachAnswer(F f) const;
+
+    double ways(int level, uint64_t state);
+    int    remaining(uint64_t state, int c) const { return (int)(state / classes_[c].stride % (classes_[c].size + 1)); }
+
+    Constraints constraints_;
+    bool feasible_;                             // False if the constraints are contradictory
+    uint64_t known_;                            // Cards whose holders are known
+    std::vector<Class> classes_;                // Classes of cards whose holders are not known
+    uint64_t full_;                             // State with all cards of every class remaining
+    std::vector<int> order_;                    // Players (other than the answer) in the order they are dealt cards
+    std::vector<uint64_t> holders_;             // Classes each player might hold, by player index
+    std::vector<uint64_t> holdableAfter_;       // Classes that can be held by players after each level
+    std::vector<int> minAfter_;                 // Fewest cards that can be held by players after each level
+    std::vector<int> maxAfter_;                 // Most cards that can be held by players after each level
+    std::vector<int> minCards_;                 // Fewest unknown cards each player can hold, by player index
+    std::vector<int> maxCards_;                 // Most unknown cards each player can hold, by player index
+    std::vector<std::vector<uint64_t>> clauses_;// Sets of classes each player must hold at least one of, by player index
+    std::vector<uint64_t> answerChoices_;       // Classes the answer can choose from for each type (0 if already known)
+    std::vector<uint64_t> answerNotAll_;        // Sets of (single card) classes the answer does not hold all of
+    std::vector<Memo> memo_;                    // Number of ways to deal the remaining cards, by level and state
+};
+
+#endif // !defined(EXACTCOUNTER_H)
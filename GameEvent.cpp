@@ -0,0 +1,191 @@
+#include "GameEvent.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+using json = nlohmann::json;
+
+GameEvent GameEvent::fromJson(json const & event, Solver const & solver)
+{
+    GameEvent e;
+    e.correct = false;
+    e.count   = 0;
+    if (event.find("show") != event.end())
+    {
+        auto const & s = event.at("show");
+        e.kind   = SHOW;
+        e.player = s.at("player").get<Solver::Id>();
+        if (!solver.playerIsValid(e.player))
+            throw std::domain_error("Invalid player");
+        e.cards.push_back(s.at("card").get<Solver::Id>());
+        if (!solver.cardIsValid(e.cards[0]))
+            throw std::domain_error("Invalid card");
+    }
+    else if (event.find("suggest") != event.end())
+    {
+        auto const & s = event.at("suggest");
+        e.kind   = SUGGEST;
+        e.player = s.at("player").get<Solver::Id>();
+        if (!solver.playerIsValid(e.player))
+            throw std::domain_error("Invalid player");
+        e.cards = s.at("cards").get<Solver::IdList>();
+        if (!solver.cardsAreValid(e.cards))
+            throw std::domain_error("Invalid cards");
+        e.showed = s.at("showed").get<Solver::IdList>();
+        if (!solver.playersAreValid(e.showed))
+            throw std::domain_error("Invalid players");
+    }
+    else if (event.find("hand") != event.end())
+    {
+        auto const & h = event.at("hand");
+        e.kind   = HAND;
+        e.player = h.at("player").get<Solver::Id>();
+        e.cards  = h.at("cards").get<Solver::IdList>();
+        if (!solver.playerIsValid(e.player))
+            throw std::domain_error("Invalid player");
+        if (!solver.cardsAreValid(e.cards))
+            throw std::domain_error("Invalid hand");
+    }
+    else if (event.find("accuse") != event.end())
+    {
+        auto const & a = event.at("accuse");
+        e.kind   = ACCUSE;
+        e.player = a.at("player").get<Solver::Id>();
+        if (!solver.playerIsValid(e.player))
+            throw std::domain_error("Invalid player");
+        e.cards = a.at("cards").get<Solver::IdList>();
+        if (!solver.cardsAreValid(e.cards))
+            throw std::domain_error("Invalid cards");
+        e.correct = a.at("correct").get<bool>();
+    }
+    else if (event.find("undo") != event.end())
+    {
+        e.kind  = UNDO;
+        e.count = event.at("undo").get<int>();
+        if (e.count < 1)
+            throw std::domain_error("Invalid count");
+    }
+    else
+    {
+        throw std::domain_error("Invalid event type");
+    }
+    return e;
+}
+
+json GameEvent::toJson() const
+{
+    json j;
+    switch (kind)
+    {
+        case HAND:
+            j["hand"] = { { "player", player }, { "cards", cards } };
+            break;
+        case SHOW:
+            j["show"] = { { "player", player }, { "card", cards[0] } };
+            break;
+        case SUGGEST:
+            j["suggest"] = { { "player", player }, { "cards", cards }, { "showed", showed } };
+            break;
+        case ACCUSE:
+            j["accuse"] = { { "player", player }, { "cards", cards }, { "correct", correct } };
+            break;
+        case UNDO:
+            j["undo"] = count;
+            break;
+    }
+    return j;
+}
+
+void EventApplier::apply(GameEvent const & event)
+{
+    switch (event.kind)
+    {
+        case GameEvent::HAND:
+            solver_.hand(event.player, event.cards);
+            break;
+        case GameEvent::SHOW:
+            solver_.show(event.player, event.cards[0]);
+            break;
+        case GameEvent::SUGGEST:
+            solver_.suggest(event.player, event.cards, event.showed, suggestionId());
+            break;
+        case GameEvent::ACCUSE:
+            solver_.accuse(event.player, event.cards, event.correct, accusationId());
+            break;
+        case GameEvent::UNDO:
+            undo(event.count);
+            break;
+    }
+}
+
+void EventApplier::applyBatch(std::vector<GameEvent> const & events)
+{
+    // The suggestions and accusations are numbered as they would be if the events were applied one at a time
+    std::vector<Solver::BatchEvent> batch;
+    int                             suggestionId = solver_.suggestionCount();
+    int                             accusationId = solver_.accusationCount();
+    for (auto const & e : events)
+    {
+        if (e.kind == GameEvent::UNDO)
+        {
+            solver_.applyBatch(batch);
+            batch.clear();
+            undo(e.count);
+            suggestionId = solver_.suggestionCount();
+            accusationId = solver_.accusationCount();
+            continue;
+        }
+
+        Solver::BatchEvent b;
+        b.player  = solver_.playerIndex(e.player);
+        b.correct = e.correct;
+        b.id      = -1;
+        for (auto const & c : e.cards)
+        {
+            b.cards.push_back(solver_.cardIndex(c));
+        }
+        for (auto const & p : e.showed)
+        {
+            b.showed.push_back(solver_.playerIndex(p));
+        }
+        switch (e.kind)
+        {
+            case GameEvent::HAND:
+                b.kind = Solver::BatchEvent::HAND;
+                break;
+            case GameEvent::SHOW:
+                b.kind = Solver::BatchEvent::SHOW;
+                break;
+            case GameEvent::SUGGEST:
+                b.kind = Solver::BatchEvent::SUGGEST;
+                b.id   = suggestionId++;
+                break;
+            case GameEvent::ACCUSE:
+                b.kind = Solver::BatchEvent::ACCUSE;
+                b.id   = accusationId++;
+                break;
+            case GameEvent::UNDO:
+                break;
+        }
+        batch.push_back(std::move(b));
+    }
+    solver_.applyBatch(batch);
+}
+
+int EventApplier::undo(int count)
+{
+    return solver_.undo(count);
+}
+
+void EventApplier::replace(int index, std::vector<GameEvent> const & events)
+{
+    assert(index >= 0 && index <= this->events());
+    undo(this->events() - index);
+    for (auto const & e : events)
+    {
+        apply(e);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#if !defined(GAMEEVENT_H)
+#define GAMEEVENT_H 1
+
+#include "Solver.h"
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <vector>
+
+//! An event in a game
+struct GameEvent
+{
+    //! The kind of event
+    enum Kind
+    {
+        HAND,                   //!< The player's hand
+        SHOW,                   //!< The player showed a card (cards holds the card)
+        SUGGEST,                //!< The player made a suggestion
+        ACCUSE,                 //!< The player made an accusation
+        UNDO                    //!< The latest events are undone (count holds the number of events)
+    };
+
+    Kind kind = HAND;
+    Solver::Id player;          //!< Player the event is about
+    Solver::IdList cards;       //!< Cards in the hand, suggestion, or accusation, or the card shown
+    Solver::IdList showed;      //!< Players that responded to a suggestion
+    bool correct = false;       //!< True if an accusation is correct
+    int count = 0;              //!< Number of events to undo
+
+    //! Reads an event from its JSON form (for example, { "show" : { "player" : "chris", "card" : "knife" } }), checking
+    //! that the players and cards are valid. Throws std::domain_error if the event is not valid.
+    static GameEvent fromJson(nlohmann::json const & json, Solver const & solver);
+
+    //! Returns the JSON form of the event
+    nlohmann::json toJson() const;
+};
+
+//! Applies events to a solver, numbering the suggestions and the accusations in the order they are applied. The
+//! numbering follows the solver's own count of suggestions and accusations, so it continues correctly after events are
+//! undone or the solver is restored from a snapshot.
+class EventApplier
+{
+public:
+    //! Constructor
+    explicit EventApplier(Solver & solver) : solver_(solver) {}
+
+    //! Applies an event. An UNDO event undoes the latest events (it cannot be undone itself).
+    void apply(GameEvent const & event);
+
+    //! Applies events as a batch (see Solver::applyBatch()), for when only what is known after the last one matters.
+    //! An UNDO event ends a batch, and the events after it start another one.
+    void applyBatch(std::vector<GameEvent> const & events);
+
+    //! Undoes the latest events. Returns the number of events undone, which is less than the number requested if there
+    //! are fewer events.
+    int undo(int count);
+
+    //! Replaces the events applied since the given one (counting from 0): they are undone, and the replacements are
+    //! applied instead. To edit a past event, pass the edited event followed by the events after it. Only the deductions
+    //! made since the first replaced event are repeated.
+    void replace(int index, std::vector<GameEvent> const & events);
+
+    //! Returns the number of events applied so far, not including those that were undone
+    int events() const { return solver_.events(); }
+
+    //! Returns the ID of the next suggestion
+    int suggestionId() const { return solver_.suggestionCount(); }
+
+    //! Returns the ID of the next accusation
+    int accusationId() const { return solver_.accusationCount(); }
+
+private:
+    Solver & solver_;
+};
+
+#endif // !defined(GAMEEVENT_H)
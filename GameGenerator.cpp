@@ -0,0 +1,138 @@
+#include "GameGenerator.h"
+
+#include "Configuration.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace
+{
+double const ACCUSATION_RATE          = 0.03;  // Chance that a player makes an accusation instead of a suggestion
+double const OWN_CARD_SUGGESTION_RATE = 0.2;   // Chance that a player suggests a card of a type without avoiding its own
+} // anonymous namespace
+
+void Game::write(std::ostream & out) const
+{
+    out << json(players).dump() << std::endl;
+    for (auto const & e : events)
+    {
+        out << e.toJson().dump() << std::endl;
+    }
+}
+
+GameGenerator::GameGenerator(Configuration const & configuration, uint64_t seed)
+    : configuration_(configuration)
+    , rng_(seed)
+{
+    for (auto const & t : configuration_.types)
+    {
+        Solver::IdList cards;
+        for (auto const & c : configuration_.cards)
+        {
+            if (c.second.type == t.first)
+                cards.push_back(c.first);
+        }
+        types_.push_back(cards);
+    }
+}
+
+Game GameGenerator::generate(int players, int turns)
+{
+    bool master = (configuration_.rules == "master");
+    Game game;
+    for (int i = 0; i < players; ++i)
+    {
+        game.players.push_back("p" + std::to_string(i));
+    }
+
+    // Deal the cards
+    auto pick = [this] (Solver::IdList const & cards) -> Solver::Id const & {
+        return cards[std::uniform_int_distribution<size_t>(0, cards.size() - 1)(rng_)];
+    };
+    Solver::IdList rest;
+    for (auto const & t : types_)
+    {
+        game.answer.push_back(pick(t));
+    }
+    for (auto const & c : configuration_.cards)
+    {
+        if (std::find(game.answer.begin(), game.answer.end(), c.first) == game.answer.end())
+            rest.push_back(c.first);
+    }
+    std::shuffle(rest.begin(), rest.end(), rng_);
+    std::vector<Solver::IdList> hands(players);
+    for (size_t i = 0; i < rest.size(); ++i)
+    {
+        hands[i % players].push_back(rest[i]);
+    }
+    auto holds = [&hands] (int p, Solver::Id const & card) {
+        return std::find(hands[p].begin(), hands[p].end(), card) != hands[p].end();
+    };
+
+    game.events.push_back({ GameEvent::HAND, game.players[0], hands[0], {}, false });
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    for (int turn = 0; turn < turns; ++turn)
+    {
+        int p = turn % players;
+
+        // Players mostly suggest and accuse cards that they don't hold
+        Solver::IdList cards;
+        bool           accusing = chance(rng_) < ACCUSATION_RATE;
+        for (auto const & t : types_)
+        {
+            Solver::IdList others;
+            std::copy_if(t.begin(), t.end(), std::back_inserter(others), [&] (auto const & c) { return !holds(p, c); });
+            if (others.empty() || (!accusing && chance(rng_) < OWN_CARD_SUGGESTION_RATE))
+                cards.push_back(pick(t));
+            else
+                cards.push_back(pick(others));
+        }
+
+        if (accusing)
+        {
+            bool correct = std::is_permutation(cards.begin(), cards.end(), game.answer.begin());
+            game.events.push_back({ GameEvent::ACCUSE, game.players[p], cards, {}, correct });
+            if (correct)
+                break;
+            continue;
+        }
+
+        // The other players respond in turn. Under Master Detective rules, every player holding a suggested card shows
+        // one. Under Classic rules, the players respond until one of them shows a card.
+        Solver::IdList         showed;
+        std::vector<GameEvent> shows;
+        for (int i = 1; i < players; ++i)
+        {
+            int            q = (p + i) % players;
+            Solver::IdList held;
+            std::copy_if(cards.begin(), cards.end(), std::back_inserter(held), [&] (auto const & c) { return holds(q, c); });
+            if (master)
+            {
+                if (!held.empty())
+                    showed.push_back(game.players[q]);
+            }
+            else
+            {
+                showed.push_back(game.players[q]);
+            }
+            if (!held.empty())
+            {
+                shows.push_back({ GameEvent::SHOW, game.players[q], { pick(held) }, {}, false });
+                if (!master)
+                    break;
+            }
+        }
+        if (shows.empty())
+            showed.clear();
+
+        game.events.push_back({ GameEvent::SUGGEST, game.players[p], cards, showed, false });
+        if (p == 0)
+            game.events.insert(game.events.end(), shows.begin(), shows.end());
+    }
+    return game;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#if !defined(GAMEGENERATOR_H)
+#define GAMEGENERATOR_H 1
+
+#include "GameEvent.h"
+#include "Solver.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <vector>
+
+struct Configuration;
+
+//! A game, as seen by the first player
+struct Game
+{
+    Solver::IdList players;             //!< Players, in the order they take turns
+    Solver::IdList answer;              //!< Cards in the answer
+    std::vector<GameEvent> events;      //!< Events, in order
+
+    //! Writes the game in the format read by ClueSolver
+    void write(std::ostream & out) const;
+};
+
+//! Generates random games that follow the rules.
+//!
+//! The cards are dealt randomly and the players take turns making suggestions, mostly of cards that they do not hold.
+//! The other players respond according to the rules, and the cards shown to the first player are revealed. Now and then
+//! a player makes an accusation of cards it does not hold, and the game ends when an accusation is correct.
+class GameGenerator
+{
+public:
+    //! Constructor
+    GameGenerator(Configuration const & configuration, uint64_t seed);
+
+    //! Generates a game with the given number of players and at most the given number of turns
+    Game generate(int players, int turns);
+
+private:
+    Configuration const & configuration_;
+    std::vector<Solver::IdList> types_;     // Cards of each type
+    std::mt19937_64 rng_;
+};
+
+#endif // !defined(GAMEGENERATOR_H)
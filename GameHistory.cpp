@@ -0,0 +1,46 @@
+#include "GameHistory.h"
+
+#include <cassert>
+
+GameHistory::GameHistory(Solver::Rules const & rules, Solver::IdList const & players, int interval /*= 16*/)
+    : rules_(rules)
+    , interval_(interval)
+    , solver_(rules, players)
+    , applier_(solver_)
+{
+    assert(interval > 0);
+    snapshots_.push_back(solver_.snapshot(false));
+}
+
+void GameHistory::apply(GameEvent const & event)
+{
+    applier_.apply(event);
+    if (event.kind == GameEvent::UNDO)
+    {
+        // The snapshots taken after the remaining events are no longer valid
+        events_.resize(applier_.events());
+        snapshots_.resize(events_.size() / interval_ + 1);
+        return;
+    }
+
+    events_.push_back(event);
+    if (events_.size() % interval_ == 0)
+        snapshots_.push_back(solver_.snapshot(false));
+}
+
+Solver GameHistory::at(int events) const
+{
+    assert(0 <= events && events <= size());
+    // The discoveries are not part of a snapshot, so the event that made them is always applied again. Only what is
+    // known after the events before it matters, so they are applied as a batch.
+    int                 i        = (events > 0) ? (events - 1) / interval_ : 0;
+    std::string const & snapshot = snapshots_[i];
+    Solver              solver   = Solver::restore(rules_, snapshot.data(), snapshot.size());
+    EventApplier        applier(solver);
+    if (events > i * interval_)
+    {
+        applier.applyBatch(std::vector<GameEvent>(events_.begin() + i * interval_, events_.begin() + events - 1));
+        applier.apply(events_[events - 1]);
+    }
+    return solver;
+}
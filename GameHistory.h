@@ -0,0 +1,50 @@
+#pragma once
+#if !defined(GAMEHISTORY_H)
+#define GAMEHISTORY_H 1
+
+#include "GameEvent.h"
+#include "Solver.h"
+
+#include <string>
+#include <vector>
+
+//! The events of a game, with snapshots of the solver taken periodically so that what was known after any event can be
+//! reconstructed quickly.
+//!
+//! The state after an event is reconstructed by restoring the latest snapshot taken at or before it and then applying at
+//! most interval events. A shorter interval makes the reconstruction faster and a longer one uses less memory.
+class GameHistory
+{
+public:
+    //! Constructor
+    GameHistory(Solver::Rules const & rules, Solver::IdList const & players, int interval = 16);
+
+    GameHistory(GameHistory const &)             = delete;
+    GameHistory & operator=(GameHistory const &) = delete;
+
+    //! Applies an event to the current state and adds it to the history. An UNDO event removes the latest events from
+    //! the history.
+    void apply(GameEvent const & event);
+
+    //! Returns the number of events in the history
+    int size() const { return (int)events_.size(); }
+
+    //! Returns the state after the given number of events (0 is the state before the first event)
+    Solver at(int events) const;
+
+    //! Returns the current state
+    Solver const & solver() const { return solver_; }
+
+    //! Returns the events, in order
+    std::vector<GameEvent> const & events() const { return events_; }
+
+private:
+    Solver::Rules rules_;
+    int interval_;                          // Number of events between snapshots
+    Solver solver_;                         // Current state
+    EventApplier applier_;                  // Applies the events to the current state
+    std::vector<GameEvent> events_;         // Events, in order
+    std::vector<std::string> snapshots_;    // Snapshot i is the state after i * interval_ events
+};
+
+#endif // !defined(GAMEHISTORY_H)
@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(char const * path)
+    : valid_(false)
+    , data_(nullptr)
+    , size_(0)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return;
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    contents_ = contents.str();
+    data_     = contents_.data();
+    size_     = contents_.size();
+    valid_    = true;
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#else // defined(_WIN32)
+
+MappedFile::MappedFile(char const * path)
+    : valid_(false)
+    , data_(nullptr)
+    , size_(0)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat status;
+    if (fstat(fd, &status) == 0)
+    {
+        size_ = (size_t)status.st_size;
+        if (size_ == 0)
+        {
+            // An empty file cannot be mapped, but it is still a valid file
+            valid_ = true;
+        }
+        else
+        {
+            void * data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                // The file is read once from start to end
+                madvise(data, size_, MADV_SEQUENTIAL);
+                data_  = data;
+                valid_ = true;
+            }
+        }
+    }
+
+    // The mapping stays valid after the file is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        munmap(const_cast<void *>(data_), size_);
+}
+
+#endif // defined(_WIN32)
@@ -0,0 +1,42 @@
+#pragma once
+#if !defined(MAPPEDFILE_H)
+#define MAPPEDFILE_H 1
+
+#include <cstddef>
+#include <string>
+
+//! A file mapped into memory for reading.
+//!
+//! The file's contents are read directly from the page cache, without being copied. Where files cannot be mapped
+//! (Windows), the contents are read into memory instead.
+class MappedFile
+{
+public:
+    //! Constructor. Maps the named file. If it cannot be opened, the file is not valid.
+    explicit MappedFile(char const * path);
+
+    //! Destructor
+    ~MappedFile();
+
+    MappedFile(MappedFile const &)             = delete;
+    MappedFile & operator=(MappedFile const &) = delete;
+
+    //! Returns true if the file was opened
+    bool valid() const { return valid_; }
+
+    //! Returns the contents of the file
+    void const * data() const { return data_; }
+
+    //! Returns the size of the file in bytes
+    size_t size() const { return size_; }
+
+private:
+    bool         valid_;
+    void const * data_;
+    size_t       size_;
+#if defined(_WIN32)
+    std::string contents_;
+#endif
+};
+
+#endif // !defined(MAPPEDFILE_H)
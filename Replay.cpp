@@ -0,0 +1,544 @@
+#include "Replay.h"
+
+#include "Bits.h"
+#include "Configuration.h"
+#include "EventLog.h"
+#include "EventParser.h"
+#include "GameEvent.h"
+#include "SpscQueue.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace
+{
+size_t const QUEUE_CAPACITY = 1024;         // Most events waiting between two stages of a pipelined replay
+size_t const MAX_BATCH_SIZE = 64 * 1024;    // Most output held back by a pipelined replay before it is written
+
+void listCards(std::ostream &               out,
+               Solver::Id const &           typeId,
+               Solver::TypeInfoList const & typeInfo,
+               Solver::CardInfoList const & cards)
+{
+    out << typeInfo.find(typeId)->second.title << ": ";
+    bool first = true;
+    for (auto const & c : cards)
+    {
+        if (c.second.type == typeId)
+        {
+            if (!first)
+                out << ", ";
+            out << c.second.name;
+            first = false;
+        }
+    }
+    out << '\n';
+}
+
+void listTypes(std::ostream & out, Solver::TypeInfoList const & types)
+{
+    out << "Types: ";
+    bool first = true;
+    for (auto const & t : types)
+    {
+        if (!first)
+            out << ", ";
+        out << t.first;
+        first = false;
+    }
+    out << '\n';
+}
+
+void outputSuggestion(std::ostream &         out,
+                      Configuration const &  configuration,
+                      int                    id,
+                      Solver::Id const &     player,
+                      Solver::IdList const & cards,
+                      Solver::IdList const & results)
+{
+    out << '(' << std::setw(2) << id << ") " << player << " suggested";
+
+    for (auto const & c : cards)
+    {
+        Solver::TypeInfo const & typeInfo = configuration.typeOf(c);
+        out << " " << typeInfo.preposition << typeInfo.article << configuration.card(c).name;
+    }
+
+    out << " ==> ";
+    if (results.empty())
+    {
+        out << "nobody has them";
+    }
+    else
+    {
+        if (configuration.rules == "master")
+        {
+            out << results[0];
+            for (size_t i = 1; i < results.size(); ++i)
+            {
+                out << ", " << results[i];
+            }
+            out << " showed a card";
+        }
+        else
+        {
+            if (results.size() > 1)
+            {
+                out << results[0];
+                for (size_t i = 1; i < results.size()-1; ++i)
+                {
+                    out << ", " << results[i];
+                }
+                out << " had nothing, but ";
+            }
+            out << results.back() << " showed a card";
+        }
+    }
+    out << '\n';
+}
+
+void outputShow(std::ostream & out, Configuration const & configuration, Solver::Id const & player, Solver::Id const & card)
+{
+    out << "---- " << player << " showed " << configuration.typeOf(card).article << configuration.card(card).name << '\n';
+}
+
+void outputHand(std::ostream &         out,
+                Configuration const &  configuration,
+                Solver::Id const &     player,
+                Solver::IdList const & cards)
+{
+    out << "**** " << player << " has this hand: ";
+    out << configuration.card(cards[0]).name;
+    for (size_t i = 1; i < cards.size(); ++i)
+    {
+        out << ", " << configuration.card(cards[i]).name;
+    }
+    out << '\n';
+}
+
+void outputProbabilities(std::ostream & out, Solver::ProbabilityTable const & probabilities)
+{
+    // List the cards the answer might hold, most likely first
+    std::vector<std::pair<double, Solver::Id>> answer;
+    for (auto const & c : probabilities.find(Solver::ANSWER_PLAYER_ID)->second)
+    {
+        if (c.second > 0.0)
+            answer.emplace_back(c.second, c.first);
+    }
+    std::stable_sort(answer.begin(), answer.end(), [] (auto const & a, auto const & b) { return a.first > b.first; });
+
+    out << "P(ANSWER):";
+    for (auto const & a : answer)
+    {
+        out << " " << a.second << " " << std::fixed << std::setprecision(3) << a.first << std::defaultfloat;
+    }
+    out << '\n';
+}
+
+void outputAccusation(std::ostream &         out,
+                      Configuration const &  configuration,
+                      int                    id,
+                      Solver::Id const &     player,
+                      Solver::IdList const & cards,
+                      bool                   correct)
+{
+    out << '(' << std::setw(2) << id << ") " << player << " accused";
+
+    for (auto const & c : cards)
+    {
+        Solver::TypeInfo const & typeInfo = configuration.typeOf(c);
+        out << " " << typeInfo.preposition << typeInfo.article << configuration.card(c).name;
+    }
+
+    out << " ==> " << (correct ? "correct" : "wrong");
+    out << '\n';
+}
+
+void outputUndo(std::ostream & out, int count)
+{
+    out << "<<<< undo " << count << ((count == 1) ? " event" : " events") << '\n';
+}
+
+// An event as it passes through a replay: read, applied, and reported. The same object is used for one event after
+// another, so once its lists have grown, an event allocates little.
+struct ReplayEvent
+{
+    GameEvent                event;
+    EventIndexes             indexes;
+    int                      position = 0;      // Line (or record) the event came from
+    bool                     valid    = false;  // True if the event was read (it is reported even if it then failed)
+    int                      id       = 0;      // Suggestion or accusation ID, or the number of events undone
+    Solver::DiscoveryList    discoveries;
+    Solver::IdList           answer;
+    Solver::ProbabilityTable probabilities;     // Only if they are wanted
+    std::string              error;             // Why the event could not be read or applied, if it failed
+    std::string              input;             // The text of an event that could not be read
+    bool                     end = false;       // True if there are no more events
+};
+
+// Reads the next event. Returns false if there are no more.
+bool parseEvent(EventParser & parser, ReplayEvent & e)
+{
+    e.valid = false;
+    e.error.clear();
+    e.input.clear();
+    try
+    {
+        if (!parser.next(e.event, e.indexes))
+            return false;
+        e.valid = true;
+    }
+    catch (std::exception const & x)
+    {
+        e.error = x.what();
+        e.input.assign(parser.text());
+    }
+    e.position = parser.line();
+    return true;
+}
+
+// Applies an event that was read to the solver, by index, and collects its results. If it fails, the error names the
+// event's position with the given word.
+void solveEvent(Solver & solver, ReplayOptions const & options, char const * unit, ReplayEvent & e)
+{
+    if (!e.valid)
+        return;
+    try
+    {
+        EventIndexes const & x = e.indexes;
+        switch (e.event.kind)
+        {
+            case GameEvent::HAND:
+                solver.hand(x.player, x.cards);
+                break;
+            case GameEvent::SHOW:
+                solver.show(x.player, x.cards[0]);
+                break;
+            case GameEvent::SUGGEST:
+                e.id = solver.suggestionCount();
+                solver.suggest(x.player, x.cards, x.showed, e.id);
+                break;
+            case GameEvent::ACCUSE:
+                e.id = solver.suggestionCount();
+                solver.accuse(x.player, x.cards, e.event.correct, solver.accusationCount());
+                break;
+            case GameEvent::UNDO:
+                e.id = solver.undo(e.event.count);
+                break;
+        }
+        e.discoveries = solver.latestDiscoveries();
+        e.answer      = solver.mightBeHeldBy(Solver::ANSWER_PLAYER_ID);
+        if (options.showProbabilities)
+            e.probabilities = solver.probabilities(options.probability);
+    }
+    catch (std::exception const & x)
+    {
+        e.error = std::string(unit) + " " + std::to_string(e.position) + ": " + x.what();
+    }
+}
+
+// Writes the results of an event to the output, or the reason it failed to the error stream. The solver is only used to
+// describe the discoveries, so it can be a copy.
+void renderEvent(std::ostream &        out,
+                 std::ostream &        errors,
+                 Configuration const & configuration,
+                 Solver const &        solver,
+                 ReplayOptions const & options,
+                 ReplayEvent const &   e)
+{
+    if (e.valid)
+    {
+        GameEvent const & event = e.event;
+        switch (event.kind)
+        {
+            case GameEvent::SHOW:
+                outputShow(out, configuration, event.player, event.cards[0]);
+                break;
+            case GameEvent::SUGGEST:
+                outputSuggestion(out, configuration, e.id, event.player, event.cards, event.showed);
+                break;
+            case GameEvent::HAND:
+                outputHand(out, configuration, event.player, event.cards);
+                break;
+            case GameEvent::ACCUSE:
+                outputAccusation(out, configuration, e.id, event.player, event.cards, event.correct);
+                break;
+            case GameEvent::UNDO:
+                outputUndo(out, e.id);
+                break;
+        }
+    }
+    if (!e.error.empty())
+    {
+        errors << e.error;
+        if (!e.input.empty())
+            errors << ": '" << e.input << "'";
+        errors << std::endl;
+        return;
+    }
+
+    for (auto const & d : e.discoveries)
+    {
+        out << "     -> " << solver.describe(d) << '\n';
+    }
+    out << "ANSWER: " << json(e.answer).dump() << '\n';
+    if (options.showProbabilities)
+        outputProbabilities(out, e.probabilities);
+    out << '\n';
+}
+
+// Writes the rules, the cards and the players
+void outputHeader(std::ostream & out, Configuration const & configuration, Solver::IdList const & players)
+{
+    out << "Rules: " << configuration.rules << '\n';
+    listTypes(out, configuration.types);
+    for (auto const & t : configuration.types)
+    {
+        listCards(out, t.first, configuration.types, configuration.cards);
+    }
+
+    out << '\n';
+    out << "players = " << json(players).dump() << '\n';
+    out << '\n';
+}
+
+// Reads an event from a record of an event log, as indexes for the solver and as IDs for the output. The lists are
+// reused from one event to the next, so once they have grown, reading an event allocates nothing. Throws
+// std::domain_error if the record is not valid.
+void decodeEvent(EventRecord const & record, Solver const & solver, GameEvent & event, EventIndexes & indexes)
+{
+    int  players = solver.playerCount();
+    int  answer  = solver.playerIndex(Solver::ANSWER_PLAYER_ID);
+    auto valid   = [&] (int player) { return player < players && player != answer; };
+
+    if (record.kind > GameEvent::UNDO)
+        throw std::domain_error("Invalid event type");
+    event.kind    = (GameEvent::Kind)record.kind;
+    event.correct = false;
+    event.count   = 0;
+    std::vector<int> & cards  = indexes.cards;
+    std::vector<int> & showed = indexes.showed;
+    cards.clear();
+    showed.clear();
+    if (event.kind == GameEvent::UNDO)
+    {
+        if (record.value < 1 || record.value > INT32_MAX)
+            throw std::domain_error("Invalid count");
+        event.count = (int)record.value;
+        return;
+    }
+
+    if (!valid(record.player))
+        throw std::domain_error("Invalid player");
+    indexes.player = record.player;
+    if (event.kind == GameEvent::HAND)
+    {
+        if (countBits(record.cards) != record.cardCount || (solver.cardCount() < 64 && (record.cards >> solver.cardCount())))
+            throw std::domain_error("Invalid hand");
+        forEachBit(record.cards, [&] (int c) { cards.push_back(c); });
+    }
+    else
+    {
+        if (record.cardCount < 1 || record.cardCount > EventRecord::MAX_CARDS ||
+            (event.kind == GameEvent::SHOW && record.cardCount != 1))
+            throw std::domain_error("Invalid cards");
+        for (int i = 0; i < record.cardCount; ++i)
+        {
+            int c = (int)((record.cards >> (8 * i)) & 0xff);
+            if (c >= solver.cardCount())
+                throw std::domain_error("Invalid cards");
+            cards.push_back(c);
+        }
+        if (event.kind == GameEvent::SUGGEST)
+        {
+            if (record.showedCount > EventRecord::MAX_SHOWED)
+                throw std::domain_error("Invalid players");
+            for (int i = 0; i < record.showedCount; ++i)
+            {
+                if (!valid(record.showed[i]))
+                    throw std::domain_error("Invalid players");
+                showed.push_back(record.showed[i]);
+            }
+        }
+        event.correct = (event.kind == GameEvent::ACCUSE) && record.value != 0;
+    }
+
+    event.player = solver.playerId(record.player);
+    event.cards.resize(cards.size());
+    for (size_t i = 0; i < cards.size(); ++i)
+    {
+        event.cards[i] = solver.cardId(cards[i]);
+    }
+    event.showed.resize(showed.size());
+    for (size_t i = 0; i < showed.size(); ++i)
+    {
+        event.showed[i] = solver.playerId(showed[i]);
+    }
+}
+
+// Replays the events with each stage on its own thread: one reads the events, this one applies them, and one writes the
+// results. The stages are connected by bounded queues, through which the events' objects circulate. The output is
+// written in batches, whenever the writer has caught up with the solver or has a lot to write, and flushed after each
+// batch.
+int replayPipelined(Configuration const & configuration,
+                    std::istream &        in,
+                    std::ostream &        out,
+                    std::ostream &        errors,
+                    ReplayOptions const & options,
+                    Solver &              solver,
+                    int                   firstLine)
+{
+    SpscQueue<ReplayEvent> parsed(QUEUE_CAPACITY);
+    SpscQueue<ReplayEvent> solved(QUEUE_CAPACITY);
+
+    std::thread parser([&, validator = solver.fork()] () {
+        EventParser parser(in, validator, firstLine);
+        ReplayEvent e;
+        while (parseEvent(parser, e))
+        {
+            parsed.push(e);
+        }
+        e.end = true;
+        parsed.push(e);
+    });
+
+    std::thread writer([&, describer = solver.fork()] () {
+        std::ostringstream batch;
+        ReplayEvent        e;
+        while (true)
+        {
+            if (!solved.tryPop(e))
+            {
+                if (batch.tellp() > 0)
+                {
+                    out << batch.str();
+                    out.flush();
+                    batch.str("");
+                }
+                solved.pop(e);
+            }
+            if (e.end)
+                break;
+            renderEvent(batch, errors, configuration, describer, options, e);
+            if (batch.tellp() > (std::streamoff)MAX_BATCH_SIZE)
+            {
+                out << batch.str();
+                batch.str("");
+            }
+        }
+        out << batch.str();
+        out.flush();
+    });
+
+    int         events = 0;
+    ReplayEvent e;
+    while (true)
+    {
+        parsed.pop(e);
+        if (e.end)
+        {
+            solved.push(e);
+            break;
+        }
+        solveEvent(solver, options, "line", e);
+        if (e.error.empty())
+            ++events;
+        solved.push(e);
+    }
+
+    parser.join();
+    writer.join();
+    return events;
+}
+} // anonymous namespace
+
+int replay(Configuration const & configuration,
+           std::istream &        in,
+           std::ostream &        out,
+           std::ostream &        errors,
+           ReplayOptions const & options)
+{
+    // Load player list
+    Solver::Id input;
+    std::getline(in, input);
+    Solver::IdList players = json::parse(input);
+
+    Solver solver(configuration.solverRules(), players);
+    outputHeader(out, configuration, players);
+
+    // The events start on the second line
+    int events = 0;
+    solver.setFullInference(options.fullInference);
+    if (options.pipelined)
+    {
+        events = replayPipelined(configuration, in, out, errors, options, solver, 2);
+    }
+    else
+    {
+        EventParser parser(in, solver, 2);
+        ReplayEvent e;
+        while (parseEvent(parser, e))
+        {
+            solveEvent(solver, options, "line", e);
+            renderEvent(out, errors, configuration, solver, options, e);
+            if (e.error.empty())
+                ++events;
+        }
+    }
+    if (options.statistics)
+        options.statistics->add(solver.statistics());
+    return events;
+}
+
+int replay(Configuration const & configuration,
+           EventLog const &      log,
+           std::ostream &        out,
+           std::ostream &        errors,
+           ReplayOptions const & options)
+{
+    Solver solver(configuration.solverRules(), log.players());
+    if ((int)log.cards().size() != solver.cardCount())
+        throw std::domain_error("The event log does not match the deck");
+    for (int c = 0; c < solver.cardCount(); ++c)
+    {
+        if (log.cards()[c] != solver.cardId(c))
+            throw std::domain_error("The event log does not match the deck");
+    }
+
+    outputHeader(out, configuration, log.players());
+
+    int         events = 0;
+    ReplayEvent e;
+    solver.setFullInference(options.fullInference);
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        e.position = (int)i + 1;
+        e.valid    = false;
+        e.error.clear();
+        try
+        {
+            decodeEvent(log[i], solver, e.event, e.indexes);
+            e.valid = true;
+        }
+        catch (std::exception const & x)
+        {
+            e.error = "event " + std::to_string(e.position) + ": " + x.what();
+        }
+        solveEvent(solver, options, "event", e);
+        renderEvent(out, errors, configuration, solver, options, e);
+        if (e.error.empty())
+            ++events;
+    }
+    if (options.statistics)
+        options.statistics->add(solver.statistics());
+    return events;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#if !defined(REPLAY_H)
+#define REPLAY_H 1
+
+#include "Solver.h"
+
+#include <iosfwd>
+
+class EventLog;
+struct Configuration;
+
+//! Options for replaying a game
+struct ReplayOptions
+{
+    bool showProbabilities;                 //!< If true, the probabilities of the answer are output after each event
+    bool fullInference;                     //!< If true, the solver finds every implied fact (see Solver::setFullInference)
+    bool pipelined;                         //!< If true, reading, solving and writing run on separate threads
+    Solver::ProbabilityOptions probability; //!< How the probabilities are computed
+    Solver::Statistics * statistics;        //!< If not null, the solver's statistics are added to these after the game
+
+    ReplayOptions() : showProbabilities(false), fullInference(false), pipelined(false), statistics(nullptr) {}
+};
+
+//! Replays a game, reading the players and the events from the input and writing each event and what was discovered from
+//! it to the output. Invalid events are reported to the error stream and skipped. Returns the number of events processed.
+//!
+//! If the replay is pipelined, the events are read and checked on one thread, applied on this one, and the results are
+//! written on another, so that reading and writing a long game overlap with solving it. The output is the same either
+//! way, but it is written in batches.
+int replay(Configuration const & configuration,
+           std::istream &        in,
+           std::ostream &        out,
+           std::ostream &        errors,
+           ReplayOptions const & options = ReplayOptions());
+
+//! Replays a game from a binary event log (see EventLog), writing the same output as the replay of its JSON form, except
+//! that the cards in a hand are listed in order of ID. Invalid events are reported to the error stream and skipped.
+//! Returns the number of events processed. Throws std::domain_error if the log was written for a different deck. There
+//! is nothing to parse, so the replay is never pipelined.
+int replay(Configuration const & configuration,
+           EventLog const &      log,
+           std::ostream &        out,
+           std::ostream &        errors,
+           ReplayOptions const & options = ReplayOptions());
+
+#endif // !defined(REPLAY_H)
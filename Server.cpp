@@ -0,0 +1,450 @@
+#include "Server.h"
+
+#if !defined(_WIN32)
+
+#include "Configuration.h"
+#include "GameEvent.h"
+#include "GameHistory.h"
+#include "Solver.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+size_t const MAX_REQUEST_SIZE = 1 << 20;   // Connections sending longer lines are closed
+size_t const READ_SIZE        = 4096;
+
+#if defined(MSG_NOSIGNAL)
+int const SEND_FLAGS = MSG_NOSIGNAL;       // A closed connection is reported as an error instead of raising SIGPIPE
+#else
+int const SEND_FLAGS = 0;
+#endif
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+} // anonymous namespace
+
+struct Server::Session
+{
+    std::mutex mutex;           // Guards the history
+    GameHistory history;
+
+    Session(Solver::Rules const & rules, Solver::IdList const & players)
+        : history(rules, players)
+    {
+    }
+};
+
+struct Server::Connection
+{
+    int fd;
+    std::string input;                  // Received but incomplete request (only used by the event loop)
+    bool closing;                       // True if nothing more will be received (only used by the event loop)
+
+    std::mutex mutex;                   // Guards the members below
+    std::deque<std::string> requests;   // Requests waiting to be handled
+    std::string output;                 // Responses waiting to be sent
+    bool busy;                          // True if a worker is handling the requests
+
+    explicit Connection(int fd) : fd(fd), closing(false), busy(false) {}
+    ~Connection() { close(fd); }
+};
+
+Server::Server(Configuration const & configuration, int threads)
+    : configuration_(configuration)
+    , pool_(threads)
+    , listener_(-1)
+    , wakeReader_(-1)
+    , wakeWriter_(-1)
+    , stopping_(false)
+{
+    int fds[2];
+    if (pipe(fds) == 0)
+    {
+        wakeReader_ = fds[0];
+        wakeWriter_ = fds[1];
+        setNonBlocking(wakeReader_);
+        setNonBlocking(wakeWriter_);
+    }
+}
+
+Server::~Server()
+{
+    pool_.wait();
+    connections_.clear();
+    if (wakeReader_ >= 0)
+        close(wakeReader_);
+    if (wakeWriter_ >= 0)
+        close(wakeWriter_);
+}
+
+bool Server::run(char const * path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (wakeReader_ < 0 || strlen(path) >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path);
+
+    // A socket left behind by a previous server is removed, but nothing else is
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path);
+
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0)
+        return false;
+    if (bind(listener_, (sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener_, SOMAXCONN) != 0 ||
+        !setNonBlocking(listener_))
+    {
+        close(listener_);
+        listener_ = -1;
+        return false;
+    }
+
+    std::vector<pollfd> fds;
+    while (!stopping_)
+    {
+        fds.clear();
+        fds.push_back({ wakeReader_, POLLIN, 0 });
+        fds.push_back({ listener_, POLLIN, 0 });
+        for (auto const & c : connections_)
+        {
+            short events = c->closing ? 0 : POLLIN;
+            {
+                std::lock_guard<std::mutex> lock(c->mutex);
+                if (!c->output.empty())
+                    events |= POLLOUT;
+            }
+
+            // A connection that is waiting only for its requests to be handled is not polled, since a hang-up would be
+            // reported continuously
+            fds.push_back({ events ? c->fd : -1, events, 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents & POLLIN)
+        {
+            char buffer[256];
+            while (::read(wakeReader_, buffer, sizeof(buffer)) > 0)
+                ;
+        }
+        if (fds[1].revents & POLLIN)
+            accept();
+
+        // Receive and send what can be, and drop the connections that have failed or are finished
+        size_t i = 2;
+        for (auto it = connections_.begin(); it != connections_.end(); ++i)
+        {
+            Connection & c      = **it;
+            short        events = fds[i].revents;
+            bool         ok     = !(events & (POLLERR | POLLNVAL));
+            if (ok && (events & (POLLIN | POLLHUP)) && !c.closing)
+                ok = read(c);
+            if (ok)
+                ok = write(c);
+
+            bool finished = false;
+            if (ok)
+            {
+                std::lock_guard<std::mutex> lock(c.mutex);
+                if (!c.busy && !c.requests.empty())
+                {
+                    c.busy = true;
+                    pool_.submit([this, connection = *it] () { work(connection); });
+                }
+                finished = c.closing && !c.busy && c.output.empty();
+            }
+
+            if (!ok || finished)
+                it = connections_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    close(listener_);
+    listener_ = -1;
+    unlink(path);
+    return true;
+}
+
+void Server::stop()
+{
+    stopping_ = true;
+    wake();
+}
+
+std::string Server::handle(std::string const & request)
+{
+    json response;
+    try
+    {
+        json        r  = json::parse(request);
+        std::string id = r.at("session").get<std::string>();
+        response["session"] = id;
+
+        if (r.find("start") != r.end())
+        {
+            Solver::IdList players = r.at("start").at("players").get<Solver::IdList>();
+            Solver::IdList sorted  = players;
+            std::sort(sorted.begin(), sorted.end());
+            if (players.empty() ||
+                players.size() >= Solver::MAX_PLAYERS ||
+                std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end() ||
+                std::find(sorted.begin(), sorted.end(), Solver::ANSWER_PLAYER_ID) != sorted.end())
+            {
+                throw std::domain_error("Invalid players");
+            }
+
+            SessionPtr                  session = std::make_shared<Session>(configuration_.solverRules(), players);
+            std::lock_guard<std::mutex> lock(sessionsMutex_);
+            if (!sessions_.emplace(id, session).second)
+                throw std::domain_error("Session already exists");
+        }
+        else if (r.find("end") != r.end())
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex_);
+            if (sessions_.erase(id) == 0)
+                throw std::domain_error("Unknown session");
+        }
+        else
+        {
+            SessionPtr session;
+            {
+                std::lock_guard<std::mutex> lock(sessionsMutex_);
+                auto                        s = sessions_.find(id);
+                if (s == sessions_.end())
+                    throw std::domain_error("Unknown session");
+                session = s->second;
+            }
+
+            std::lock_guard<std::mutex> lock(session->mutex);
+            GameHistory &               history = session->history;
+            if (r.find("query") != r.end())
+            {
+                // A query about an earlier state is answered by a reconstruction of that state
+                std::optional<Solver> past;
+                if (r.find("at") != r.end())
+                {
+                    int at = r.at("at").get<int>();
+                    if (at < 0 || at > history.size())
+                        throw std::domain_error("Invalid event count");
+                    past.emplace(history.at(at));
+                }
+                Solver const & solver = past ? *past : history.solver();
+
+                std::string query = r.at("query").get<std::string>();
+                if (query == "answer")
+                {
+                    response["answer"] = solver.mightBeHeldBy(Solver::ANSWER_PLAYER_ID);
+                }
+                else if (query == "mightHold")
+                {
+                    Solver::Id card = r.at("card").get<Solver::Id>();
+                    if (!solver.cardIsValid(card))
+                        throw std::domain_error("Invalid card");
+                    response["players"] = solver.mightHold(card);
+                }
+                else if (query == "mightBeHeldBy")
+                {
+                    Solver::Id player = r.at("player").get<Solver::Id>();
+                    if (!solver.playerIsValid(player))
+                        throw std::domain_error("Invalid player");
+                    response["cards"] = solver.mightBeHeldBy(player);
+                }
+                else if (query == "discoveries")
+                {
+                    response["discoveries"] = solver.discoveries();
+                }
+                else if (query == "probabilities")
+                {
+                    // The requests are already handled in parallel, so sampling uses only this thread
+                    Solver::ProbabilityOptions options;
+                    options.sampling.threads = 1;
+                    response["probabilities"] = solver.probabilities(options);
+                }
+                else if (query == "viableAnswers")
+                {
+                    // Like sampling, the search uses only this thread
+                    response["answers"] = solver.viableAnswers(1);
+                }
+                else if (query == "advise")
+                {
+                    Solver::Id player = r.at("player").get<Solver::Id>();
+                    if (!solver.playerIsValid(player) || player == Solver::ANSWER_PLAYER_ID)
+                        throw std::domain_error("Invalid player");
+                    Solver::AdviceOptions options;
+                    options.threads = 1;
+                    if (r.find("count") != r.end())
+                        options.count = r.at("count").get<int>();
+                    response["advice"] = json::array();
+                    for (auto const & a : solver.advise(player, options))
+                    {
+                        response["advice"].push_back({ { "cards", a.cards }, { "gain", a.gain } });
+                    }
+                }
+                else
+                {
+                    throw std::domain_error("Invalid query");
+                }
+            }
+            else
+            {
+                history.apply(GameEvent::fromJson(r, history.solver()));
+                response["discoveries"] = history.solver().discoveries();
+            }
+        }
+        response["ok"] = true;
+    }
+    catch (std::exception const & e)
+    {
+        response["ok"]    = false;
+        response["error"] = e.what();
+    }
+    return response.dump();
+}
+
+void Server::accept()
+{
+    while (true)
+    {
+        int fd = ::accept(listener_, nullptr, nullptr);
+        if (fd < 0)
+            break;
+        if (!setNonBlocking(fd))
+        {
+            close(fd);
+            continue;
+        }
+        connections_.push_back(std::make_shared<Connection>(fd));
+    }
+}
+
+// Receives whatever is available and queues the complete requests. Returns false if the connection has failed.
+bool Server::read(Connection & connection)
+{
+    char buffer[READ_SIZE];
+    while (true)
+    {
+        ssize_t n = ::read(connection.fd, buffer, sizeof(buffer));
+        if (n == 0)
+        {
+            connection.closing = true;
+            break;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        connection.input.append(buffer, n);
+    }
+
+    std::vector<std::string> requests;
+    size_t                   start = 0;
+    size_t                   end;
+    while ((end = connection.input.find('\n', start)) != std::string::npos)
+    {
+        size_t length = end - start;
+        if (length > 0 && connection.input[end - 1] == '\r')
+            --length;
+        if (length > 0)
+            requests.emplace_back(connection.input, start, length);
+        start = end + 1;
+    }
+    connection.input.erase(0, start);
+    if (connection.input.size() > MAX_REQUEST_SIZE)
+        return false;
+
+    if (!requests.empty())
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        for (auto & r : requests)
+        {
+            connection.requests.push_back(std::move(r));
+        }
+    }
+    return true;
+}
+
+// Sends as much of the pending output as possible. Returns false if the connection has failed.
+bool Server::write(Connection & connection)
+{
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    while (!connection.output.empty())
+    {
+        ssize_t n = send(connection.fd, connection.output.data(), connection.output.size(), SEND_FLAGS);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.output.erase(0, n);
+    }
+    return true;
+}
+
+// Handles a connection's requests in order until there are none left
+void Server::work(ConnectionPtr connection)
+{
+    while (true)
+    {
+        std::string request;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (connection->requests.empty())
+            {
+                connection->busy = false;
+                break;
+            }
+            request = std::move(connection->requests.front());
+            connection->requests.pop_front();
+        }
+
+        std::string response = handle(request);
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->output += response;
+            connection->output += '\n';
+        }
+        wake();
+    }
+    wake();
+}
+
+// Wakes the event loop so that it sends pending responses and notices finished connections
+void Server::wake()
+{
+    char c = 0;
+    ssize_t result = ::write(wakeWriter_, &c, 1);  // If the pipe is full, the loop is already going to wake up
+    (void)result;
+}
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,86 @@
+#pragma once
+#if !defined(SERVER_H)
+#define SERVER_H 1
+
+#if !defined(_WIN32)
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Configuration;
+
+//! Hosts any number of games (sessions) for clients connected to a Unix domain socket.
+//!
+//! Requests and responses are JSON objects, one per line. Every request names its session, and a session may be used
+//! from any connection. A request either starts or ends a session, applies an event in the same form as ClueSolver's
+//! input, or queries a session:
+//!
+//!     { "session" : "s1", "start" : { "players" : [ "joe", "chris", "dave" ] } }
+//!     { "session" : "s1", "suggest" : { "player" : "joe", "cards" : [ ... ], "showed" : [ "chris" ] } }
+//!     { "session" : "s1", "undo" : 1 }
+//!     { "session" : "s1", "query" : "answer" }
+//!     { "session" : "s1", "query" : "viableAnswers" }
+//!     { "session" : "s1", "query" : "mightHold", "card" : "knife" }
+//!     { "session" : "s1", "query" : "mightHold", "card" : "knife", "at" : 0 }
+//!     { "session" : "s1", "query" : "mightBeHeldBy", "player" : "chris" }
+//!     { "session" : "s1", "query" : "discoveries" }
+//!     { "session" : "s1", "query" : "probabilities" }
+//!     { "session" : "s1", "end" : true }
+//!
+//! Each request gets a response in the order the requests were sent on the connection, with "ok" set to true and any
+//! results, or "ok" set to false and an "error". A query with "at" set to n is answered as it would have been after the
+//! first n events of the session.
+//!
+//! A single thread waits for all connections and hands complete requests to a pool of worker threads. A connection's
+//! requests are handled one at a time in order, but different connections are handled in parallel, and a session is
+//! locked only while one of its requests is handled. An idle session costs only the memory of its history.
+class Server
+{
+public:
+    //! Constructor. The configuration must outlive the server.
+    Server(Configuration const & configuration, int threads);
+
+    //! Destructor
+    ~Server();
+
+    //! Listens on the socket and handles requests until stop() is called. Returns false if the socket cannot be opened.
+    bool run(char const * path);
+
+    //! Makes run() return as soon as possible. It is safe to call this from a signal handler.
+    void stop();
+
+    //! Handles a request, returning the response
+    std::string handle(std::string const & request);
+
+private:
+    struct Session;
+    struct Connection;
+    using SessionPtr    = std::shared_ptr<Session>;
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    void accept();
+    bool read(Connection & connection);
+    bool write(Connection & connection);
+    void work(ConnectionPtr connection);
+    void wake();
+
+    Configuration const & configuration_;
+    ThreadPool pool_;
+    int listener_;                                          // Listening socket
+    int wakeReader_;                                        // Read end of the pipe used to wake the event loop
+    int wakeWriter_;                                        // Write end of the pipe used to wake the event loop
+    std::atomic<bool> stopping_;
+    std::vector<ConnectionPtr> connections_;                // Only used by the event loop
+    std::mutex sessionsMutex_;                              // Guards sessions_
+    std::unordered_map<std::string, SessionPtr> sessions_;  // Sessions by ID
+};
+
+#endif // !defined(_WIN32)
+
+#endif // !defined(SERVER_H)
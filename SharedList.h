@@ -0,0 +1,87 @@
+#pragma once
+#if !defined(SHAREDLIST_H)
+#define SHAREDLIST_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//! A list of immutable items that copies cheaply.
+//!
+//! The items are stored in fixed-size chunks that are shared by the copies of a list. A chunk is never changed while it
+//! is shared, so copying a list copies only the pointers to its chunks, and changing a copy copies at most the last
+//! chunk. Items can only be added to or removed from the end.
+template <typename T, size_t CHUNK_SIZE = 32>
+class SharedList
+{
+public:
+    //! Constructor
+    SharedList() : size_(0) {}
+
+    //! Returns the number of items
+    size_t size() const { return size_; }
+
+    //! Returns true if there are no items
+    bool empty() const { return size_ == 0; }
+
+    //! Returns an item
+    T const & operator[](size_t i) const
+    {
+        assert(i < size_);
+        return (*chunks_[i / CHUNK_SIZE])[i % CHUNK_SIZE];
+    }
+
+    //! Returns the last item
+    T const & back() const { return (*this)[size_ - 1]; }
+
+    //! Adds an item to the end
+    void push_back(T const & item)
+    {
+        if (size_ % CHUNK_SIZE == 0)
+        {
+            chunks_.push_back(std::make_shared<Chunk>());
+            chunks_.back()->reserve(CHUNK_SIZE);
+        }
+        else
+        {
+            own(size_ % CHUNK_SIZE);
+        }
+        chunks_.back()->push_back(item);
+        ++size_;
+    }
+
+    //! Removes the items after the first n
+    void truncate(size_t n)
+    {
+        assert(n <= size_);
+        chunks_.resize((n + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        if (n % CHUNK_SIZE != 0)
+        {
+            own(n % CHUNK_SIZE);
+            chunks_.back()->resize(n % CHUNK_SIZE);
+        }
+        size_ = n;
+    }
+
+private:
+    using Chunk = std::vector<T>;
+
+    // Makes sure that the last chunk is not shared before it is changed, copying its first n items if it is
+    void own(size_t n)
+    {
+        std::shared_ptr<Chunk> & last = chunks_.back();
+        if (last.use_count() > 1)
+        {
+            auto copy = std::make_shared<Chunk>();
+            copy->reserve(CHUNK_SIZE);
+            copy->assign(last->begin(), last->begin() + n);
+            last = copy;
+        }
+    }
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_;
+};
+
+#endif // !defined(SHAREDLIST_H)
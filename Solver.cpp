@@ -1,130 +1,961 @@
 #include "Solver.h"
 
+#include "Bits.h"
+#include "ClauseEngine.h"
+#include "DealSampler.h"
+#include "ExactCounter.h"
+
 #include <nlohmann/json.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SOLVER_AVX2 1
+#include <immintrin.h>
+#endif
 
 using json = nlohmann::json;
 
 namespace
 {
-template <typename T>
-json toJson(std::map<std::string, T> const & m)
+double const MAX_EXACT_COMPLEXITY = 1 << 22;   // Probabilities are sampled instead of counted if counting is more complex
+
+// Returns the index of the first shower in [start, end) for which the player's possible cards (possible[player * stride])
+// masked by the suggested cards differ from what was seen, or -1 if there is none
+int findChangedShowerScalar(uint64_t const * possible,
+                            int              stride,
+                            int const *      players,
+                            uint64_t const * cards,
+                            uint64_t const * seen,
+                            int              start,
+                            int              end)
 {
-    json j;
-    for (auto const & e : m)
+    for (int i = start; i < end; ++i)
     {
-        j[e.first] = e.second.toJson();
+        if ((possible[players[i] * stride] & cards[i]) != seen[i])
+            return i;
     }
-    return j;
+    return -1;
+}
+
+#if defined(SOLVER_AVX2)
+// Same as findChangedShowerScalar, but checks four showers at a time
+__attribute__((target("avx2")))
+int findChangedShowerAvx2(uint64_t const * possible,
+                          int              stride,
+                          int const *      players,
+                          uint64_t const * cards,
+                          uint64_t const * seen,
+                          int              start,
+                          int              end)
+{
+    __m128i strides = _mm_set1_epi32(stride);
+    int     i       = start;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128i  offsets = _mm_mullo_epi32(_mm_loadu_si128((__m128i const *)(players + i)), strides);
+        __m256i  p       = _mm256_i32gather_epi64((long long const *)possible, offsets, 8);
+        __m256i  c       = _mm256_loadu_si256((__m256i const *)(cards + i));
+        __m256i  s       = _mm256_loadu_si256((__m256i const *)(seen + i));
+        __m256i  same    = _mm256_cmpeq_epi64(_mm256_and_si256(p, c), s);
+        unsigned m       = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(same));
+        if (m != 0xf)
+            return i + lowestBit(~m & 0xf);
+    }
+    return findChangedShowerScalar(possible, stride, players, cards, seen, i, end);
+}
+#endif // defined(SOLVER_AVX2)
+
+using FindChangedShower = int (*)(uint64_t const *, int, int const *, uint64_t const *, uint64_t const *, int, int);
+
+// Returns the fastest implementation supported by this processor
+FindChangedShower selectFindChangedShower()
+{
+#if defined(SOLVER_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return findChangedShowerAvx2;
+#endif
+    return findChangedShowerScalar;
+}
+
+FindChangedShower const findChangedShower = selectFindChangedShower();
+
+// Names of the kinds of events and the reasons for discoveries in the statistics
+char const * const EVENT_NAMES[Solver::Statistics::NUMBER_OF_EVENTS] = { "hand", "show", "suggest", "accuse" };
+char const * const REASON_NAMES[Solver::Statistics::NUMBER_OF_REASONS] = {
+    "unlogged",
+    "hand",
+    "revealed",
+    "madeAccusation",
+    "holdsOtherAccusedCards",
+    "didNotShow",
+    "allCardsShown",
+    "showedOnlyPossibleCard",
+    "answerHoldsAnotherOfType",
+    "onlyCardOfTypeAnswerCanHold",
+    "nobodyElseHolds",
+    "noConsistentDeal"
+};
+
+// A snapshot starts with this header, which is followed by:
+//      the player IDs in turn order, each a 16-bit length followed by the characters,
+//      the players (possible cards, and fewest and most cards) in order of index,
+//      the cards' possible holders in order of index,
+//      the fact table,
+//      the showers' cards,
+//      the suggestions (ID, player, number of cards, number of players in showed, the cards, and the players in showed),
+//      the accusations (ID, player, number of cards, correct, active, and the cards),
+//      the changes and the marks (with whether each is settled), if the history is included.
+// Everything is in the byte order of the machine that wrote the snapshot.
+struct SnapshotHeader
+{
+    char     magic[4];      // "CLUE"
+    uint32_t byteOrder;     // SNAPSHOT_BYTE_ORDER as written
+    uint32_t version;       // SNAPSHOT_VERSION
+    uint32_t deck;          // Hash of the rules and the deck
+    uint8_t  players;       // Number of players, including the answer
+    uint8_t  cards;
+    uint8_t  types;
+    uint8_t  flags;         // SNAPSHOT_HISTORY and SNAPSHOT_FULL_INFERENCE
+    uint32_t suggestions;
+    uint32_t showers;
+    uint32_t accusations;
+    uint32_t changes;
+    uint32_t marks;
+};
+
+char const     SNAPSHOT_MAGIC[4]   = { 'C', 'L', 'U', 'E' };
+uint32_t const SNAPSHOT_VERSION    = 3;
+uint32_t const SNAPSHOT_BYTE_ORDER = 0x01020304;   // Detects snapshots written on machines with a different byte order
+
+uint8_t const SNAPSHOT_HISTORY        = 1;  // The changes and marks are included
+uint8_t const SNAPSHOT_FULL_INFERENCE = 2;  // Full inference is on
+
+// Returns a hash identifying the rules and the deck (FNV-1a)
+uint32_t deckHash(Solver::Rules const & rules)
+{
+    uint32_t hash = 2166136261u;
+    auto     add  = [&hash] (std::string const & s) {
+        for (auto c : s)
+        {
+            hash = (hash ^ (uint8_t)c) * 16777619u;
+        }
+        hash = (hash ^ 0) * 16777619u;
+    };
+    add(rules.id);
+    for (auto const & c : rules.cards)
+    {
+        add(c.first);
+        add(c.second.type);
+    }
+    return hash;
 }
 
+// Appends the bytes of a value to a snapshot
 template <typename T>
-json toJson(std::vector<T> const & v)
+void put(std::string & out, T const & value)
 {
-    json j = json::array();
-    for (auto const & e : v)
+    out.append((char const *)&value, sizeof(T));
+}
+
+// Reads the parts of a snapshot in order, throwing std::domain_error if the snapshot is too short
+class SnapshotReader
+{
+public:
+    SnapshotReader(void const * data, size_t size)
+        : next_((char const *)data)
+        , end_((char const *)data + size)
     {
-        j.push_back(e.toJson());
     }
-    return j;
+
+    template <typename T>
+    T get()
+    {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    void read(void * to, size_t size)
+    {
+        if ((size_t)(end_ - next_) < size)
+            throw std::domain_error("Invalid snapshot");
+        if (size > 0)
+            memcpy(to, next_, size);
+        next_ += size;
+    }
+
+    size_t remaining() const { return (size_t)(end_ - next_); }
+
+private:
+    char const * next_;
+    char const * end_;
+};
+
+// Throws std::domain_error if the condition is false
+void check(bool condition)
+{
+    if (!condition)
+        throw std::domain_error("Invalid snapshot");
 }
+
+// Records the time from its construction to its destruction as an event in the statistics
+class EventTimer
+{
+public:
+    EventTimer(Solver::Statistics & statistics, Solver::Statistics::Event event)
+        : statistics_(statistics)
+        , event_(event)
+        , start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~EventTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        statistics_.record(event_, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    Solver::Statistics & statistics_;
+    Solver::Statistics::Event event_;
+    std::chrono::steady_clock::time_point start_;
+};
 } // anonymous namespace
 
 char const * const Solver::ANSWER_PLAYER_ID = "ANSWER";
 
 Solver::Solver(Rules const & rules, IdList const & playerIds)
-    : rulesId_(rules.id)
+    : master_(rules.id == "master")
+    , deduceFrom_(master_ ? &Solver::deduceWithMasterRules : &Solver::deduceWithClassicRules)
+    , fullInference_(false)
 {
     assert(rules.id == "classic" || rules.id == "master");
+    // The knowledge is kept in 64-bit masks, so more cards or players cannot be represented
+    if (rules.cards.size() > MAX_CARDS)
+        throw std::domain_error("Too many cards");
+    if (playerIds.size() + 1 > MAX_PLAYERS)
+        throw std::domain_error("Too many players");
+
+    auto deck = std::make_shared<Deck>();
+    deck->hash = deckHash(rules);
+    if (rules.typeTable && rules.cardTable)
+    {
+        deck->typeTable = rules.typeTable;
+        deck->cardTable = rules.cardTable;
+    }
+    else
+    {
+        Rules copy = rules;
+        buildTables(copy);
+        deck->typeTable = copy.typeTable;
+        deck->cardTable = copy.cardTable;
+    }
+    assert(deck->typeTable->size() == (int)rules.types.size() && deck->cardTable->size() == (int)rules.cards.size());
+    for (auto const & t : rules.types)
+    {
+        deck->types.push_back({ t.first, t.second, 0 });
+    }
 
-    std::vector<Id> cardIds;
+    // Players are indexed in order of ID so that deductions are made in the same order as the IDs are sorted
+    IdList sortedPlayerIds = playerIds;
+    sortedPlayerIds.emplace_back(ANSWER_PLAYER_ID);
+    std::sort(sortedPlayerIds.begin(), sortedPlayerIds.end());
+
+    Mask allPlayers = (sortedPlayerIds.size() < 64) ? bit((int)sortedPlayerIds.size()) - 1 : ~Mask(0);
+    Mask allCards   = (rules.cards.size() < 64) ? bit((int)rules.cards.size()) - 1 : ~Mask(0);
 
-    cardIds.reserve(rules.cards.size());
     for (auto const & c : rules.cards)
     {
-        Id id = c.first;
-        cardIds.push_back(id);
-        cards_[id].possible = playerIds;
-        cards_[id].possible.emplace_back(ANSWER_PLAYER_ID);
-        cards_[id].info = c.second;
+        int index = (int)deck->cards.size();
+        int type  = deck->typeTable->find(c.second.type);
+        assert(type >= 0);
+        deck->cards.push_back({ c.first, c.second, type });
+        deck->types[type].cards |= bit(index);
+        cards_.push_back({ allPlayers });
     }
 
-    types_ = rules.types;
+    // The answer holds one card of each type, and the rest are dealt as evenly as possible, so some players may have
+    // one more card than others.
+    int dealt    = (int)(deck->cards.size() - deck->types.size());
+    int fewest   = playerIds.empty() ? 0 : dealt / (int)playerIds.size();
+    int most     = (playerIds.empty() || dealt % playerIds.size() == 0) ? fewest : fewest + 1;
+    int answered = (int)deck->types.size();
 
+    for (auto const & p : sortedPlayerIds)
+    {
+        assert(p == ANSWER_PLAYER_ID || std::count(playerIds.begin(), playerIds.end(), p) == 1);
+        deck->players.push_back(p);
+        if (p == ANSWER_PLAYER_ID)
+            players_.push_back({ allCards, answered, answered });
+        else
+            players_.push_back({ allCards, fewest, most });
+    }
+    deck->playerTable = SymbolTable(deck->players);
+    answer_           = deck->playerTable.find(ANSWER_PLAYER_ID);
     for (auto const & p : playerIds)
     {
-        assert(p != ANSWER_PLAYER_ID);
-        Player & player = players_[p];
-        player.possible = cardIds;
+        deck->turnOrder.push_back(deck->playerTable.find(p));
+    }
+    deck_ = deck;
+
+    facts_.resize(players_.size() * cards_.size(), UNKNOWN);
+    accusedCards_ = 0;
+    dirtyCards_   = 0;
+    answerHeld_   = 0;
+
+    // The answer must hold the only card of a type from the start
+    answerTypes_ = 0;
+    for (int t = 0; t < (int)deck->types.size(); ++t)
+    {
+        if (countBits(deck->types[t].cards) == 1)
+            answerTypes_ |= bit(t);
     }
-    players_[ANSWER_PLAYER_ID].possible = cardIds;
 }
 
-void Solver::hand(Id const & playerId, IdList const & cardsIds)
+void Solver::buildTables(Rules & rules)
 {
-    discoveriesLog_.clear();
-    bool changed = false;
+    IdList ids;
+    for (auto const & t : rules.types)
+    {
+        ids.push_back(t.first);
+    }
+    rules.typeTable = std::make_shared<SymbolTable const>(ids);
 
-    deduce(playerId, cardsIds, changed);
-    makeOtherDeductions(changed);
+    ids.clear();
+    for (auto const & c : rules.cards)
+    {
+        ids.push_back(c.first);
+    }
+    rules.cardTable = std::make_shared<SymbolTable const>(ids);
+}
+
+void Solver::setFullInference(bool enabled)
+{
+    fullInference_ = enabled;
+    if (!enabled)
+        engine_.reset();
+}
+
+void Solver::hand(Id const & playerId, IdList const & cardsIds)
+{
+    hand(playerIndex(playerId), cardIndexes(cardsIds));
 }
 
 void Solver::show(Id const & playerId, Id const & cardId)
 {
-    discoveriesLog_.clear();
+    show(playerIndex(playerId), cardIndex(cardId));
+}
+
+void Solver::suggest(Id const & playerId, IdList const & cardIds, IdList const & showed, int id)
+{
+    suggest(playerIndex(playerId), cardIndexes(cardIds), playerIndexes(showed), id);
+}
+
+void Solver::accuse(Id const & playerId, IdList const & cardIds, bool outcome, int id)
+{
+    accuse(playerIndex(playerId), cardIndexes(cardIds), outcome, id);
+}
+
+void Solver::hand(int player, std::vector<int> const & cards)
+{
+    EventTimer timer(statistics_, Statistics::HAND_EVENT);
+    beginEvent();
     bool changed = false;
-    deduce(playerId, cardId, changed);
+    recordHand(player, cards, changed);
     makeOtherDeductions(changed);
 }
 
-void Solver::suggest(Id const & playerId, IdList const & cardIds, IdList const & showed, int id)
+void Solver::show(int player, int card)
 {
-    discoveriesLog_.clear();
+    EventTimer timer(statistics_, Statistics::SHOW_EVENT);
+    beginEvent();
     bool changed = false;
+    recordShow(player, card, changed);
+    makeOtherDeductions(changed);
+}
 
-    Suggestion suggestion = { id, playerId, cardIds, showed };
-    suggestions_.push_back(suggestion);
+void Solver::suggest(int player, std::vector<int> const & cards, std::vector<int> const & showed, int id)
+{
+    EventTimer timer(statistics_, Statistics::SUGGEST_EVENT);
+    beginEvent();
+    bool changed = false;
+    recordSuggestion(player, cards, showed, id, changed);
+    makeOtherDeductions(changed);
+}
 
-    deduce(suggestion, changed);
+void Solver::accuse(int player, std::vector<int> const & cards, bool outcome, int id)
+{
+    EventTimer timer(statistics_, Statistics::ACCUSE_EVENT);
+    beginEvent();
+    bool changed = false;
+    recordAccusation(player, cards, outcome, id, changed);
     makeOtherDeductions(changed);
 }
 
-void Solver::accuse(Id const & playerId, IdList const & cardIds, bool outcome, int id)
+std::vector<int> Solver::applyBatch(std::vector<BatchEvent> const & events)
 {
+    static Statistics::Event const TIMERS[] = {
+        Statistics::HAND_EVENT, Statistics::SHOW_EVENT, Statistics::SUGGEST_EVENT, Statistics::ACCUSE_EVENT
+    };
+
     discoveriesLog_.clear();
-    bool changed = false;
+    std::vector<int> sources;
+    if (events.empty())
+        return sources;
 
-    Accusation accusation = { id, playerId, cardIds, outcome };
-    accusations_.push_back(accusation);
+    // Only the last event's mark is settled, since the deductions left for the end are recorded as part of it
+    bool changed = false;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        BatchEvent const & e = events[i];
+        EventTimer         timer(statistics_, TIMERS[e.kind]);
+        marks_.push_back({ changes_.size(),
+                           suggestions_.size(),
+                           showerPlayers_.size(),
+                           accusations_.size(),
+                           i + 1 == events.size() });
+        switch (e.kind)
+        {
+            case BatchEvent::HAND:
+                recordHand(e.player, e.cards, changed);
+                break;
+            case BatchEvent::SHOW:
+                assert(e.cards.size() == 1);
+                recordShow(e.player, e.cards[0], changed);
+                break;
+            case BatchEvent::SUGGEST:
+                recordSuggestion(e.player, e.cards, e.showed, e.id, changed);
+                break;
+            case BatchEvent::ACCUSE:
+                recordAccusation(e.player, e.cards, e.correct, e.id, changed);
+                break;
+        }
+        sources.resize(discoveriesLog_.size(), (int)i);
+    }
 
-    deduce(accusation, changed);
+    size_t direct = discoveriesLog_.size();
     makeOtherDeductions(changed);
+
+    // A discovery made at the end comes from a single event only if it names a suggestion or accusation in the batch
+    for (size_t d = direct; d < discoveriesLog_.size(); ++d)
+    {
+        Discovery const & discovery = discoveriesLog_[d];
+        BatchEvent::Kind  kind;
+        switch (discovery.reason)
+        {
+            case Discovery::DID_NOT_SHOW:
+            case Discovery::ALL_CARDS_SHOWN:
+            case Discovery::SHOWED_ONLY_POSSIBLE_CARD:
+                kind = BatchEvent::SUGGEST;
+                break;
+            case Discovery::MADE_ACCUSATION:
+            case Discovery::HOLDS_OTHER_ACCUSED_CARDS:
+                kind = BatchEvent::ACCUSE;
+                break;
+            default:
+                sources.push_back(-1);
+                continue;
+        }
+        auto source = std::find_if(events.begin(), events.end(), [&] (BatchEvent const & e) {
+            return e.kind == kind && e.id == discovery.event;
+        });
+        sources.push_back((source != events.end()) ? (int)(source - events.begin()) : -1);
+    }
+    return sources;
+}
+
+int Solver::undo(int count /*= 1*/)
+{
+    int undone = 0;
+    while (undone < count && !marks_.empty())
+    {
+        undoLatestEvent();
+        ++undone;
+    }
+    if (!marks_.empty() && !marks_.back().settled)
+        settleLatestEvent();
+    discoveriesLog_.clear();
+    return undone;
 }
 
 Solver::IdList Solver::mightBeHeldBy(Id const & playerId) const
 {
-    assert(players_.find(playerId) != players_.end());
-    Player const & p = players_.find(playerId)->second;
-    return p.possible;
+    return cardIds(players_[playerIndex(playerId)].possible);
 }
 
 Solver::IdList Solver::mightHold(Id const & cardId) const
 {
-    assert(cards_.find(cardId) != cards_.end());
-    Card const & c = cards_.find(cardId)->second;
-    return c.possible;
+    return playerIds(cards_[cardIndex(cardId)].possible);
+}
+
+std::vector<int> Solver::mightBeHeldBy(int player) const
+{
+    std::vector<int> cards;
+    forEachBit(players_[player].possible, [&] (int c) { cards.push_back(c); });
+    return cards;
+}
+
+std::vector<int> Solver::mightHold(int card) const
+{
+    std::vector<int> players;
+    forEachBit(cards_[card].possible, [&] (int p) { players.push_back(p); });
+    return players;
+}
+
+Solver::ProbabilityTable Solver::probabilities(ProbabilityOptions const & options /*= ProbabilityOptions()*/) const
+{
+    Constraints                      c = constraints();
+    std::vector<std::vector<double>> p;
+
+    ExactCounter counter(c);
+    if (options.method == ProbabilityOptions::EXACT ||
+        (options.method == ProbabilityOptions::AUTOMATIC && counter.complexity() <= MAX_EXACT_COMPLEXITY))
+    {
+        p = counter.probabilities();
+    }
+    else
+    {
+        DealSampler sampler(c);
+        p = sampler.probabilities(options.sampling);
+    }
+
+    ProbabilityTable table;
+    for (size_t i = 0; i < players_.size(); ++i)
+    {
+        std::map<Id, double> & row = table[deck_->players[i]];
+        for (size_t c = 0; c < cards_.size(); ++c)
+        {
+            row[deck_->cards[c].id] = p[i][c];
+        }
+    }
+    return table;
+}
+
+std::vector<Solver::IdList> Solver::viableAnswers(int threads /*= 0*/) const
+{
+    int          answer   = answer_;
+    uint64_t     possible = players_[answer].possible;
+    ClauseEngine engine(constraints());
+
+    // If there is no consistent deal, no answer is viable. Otherwise, the answer in the deal found is viable.
+    uint64_t witnessed;
+    if (!engine.allows(answer, 0, witnessed))
+        return std::vector<IdList>();
+
+    // The candidates are the combinations of one card of each type that the answer might hold
+    std::vector<uint64_t> candidates(1, 0);
+    for (auto const & t : deck_->types)
+    {
+        std::vector<uint64_t> extended;
+        for (auto candidate : candidates)
+        {
+            forEachBit(t.cards & possible, [&] (int c) { extended.push_back(candidate | bit(c)); });
+        }
+        candidates.swap(extended);
+    }
+
+    // Each worker tests the next candidate with its own copy of the engine, which keeps the clauses it learns from one
+    // candidate to the next. The copies are made before any worker starts.
+    threads = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, (int)candidates.size());
+    std::vector<ClauseEngine> engines(threads, engine);
+    std::vector<char>         viable(candidates.size(), false);
+    std::atomic<size_t>       next(0);
+    auto                      work = [&] (ClauseEngine & e) {
+        for (size_t i = next++; i < candidates.size(); i = next++)
+        {
+            uint64_t held;
+            viable[i] = (candidates[i] == witnessed) || e.allows(answer, candidates[i], held);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(work, std::ref(engines[i]));
+    }
+    work(engines[0]);
+    for (auto & w : workers)
+    {
+        w.join();
+    }
+
+    std::vector<IdList> answers;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (viable[i])
+        {
+            IdList cards;
+            for (auto const & t : deck_->types)
+            {
+                cards.push_back(deck_->cards[lowestBit(candidates[i] & t.cards)].id);
+            }
+            answers.push_back(cards);
+        }
+    }
+    return answers;
+}
+
+Solver::AdviceList Solver::advise(Id const & playerId, AdviceOptions const & options /*= AdviceOptions()*/) const
+{
+    assert(playerIsValid(playerId));
+    return advise(playerIndex(playerId), options);
+}
+
+Solver::AdviceList Solver::advise(int suggester, AdviceOptions const & options /*= AdviceOptions()*/) const
+{
+    assert(suggester != answer_);
+
+    // The candidates are every combination of one card of each type
+    std::vector<std::vector<int>> candidates(1);
+    for (auto const & t : deck_->types)
+    {
+        std::vector<std::vector<int>> extended;
+        for (auto const & candidate : candidates)
+        {
+            forEachBit(t.cards, [&] (int c) {
+                extended.push_back(candidate);
+                extended.back().push_back(c);
+            });
+        }
+        candidates.swap(extended);
+    }
+
+    // The chance of each response is estimated from deals consistent with what is known
+    std::vector<std::vector<int>> deals = DealSampler(constraints()).deals(options.samples, options.seed);
+    if (deals.empty())
+        return AdviceList();
+
+    // The other players respond in turn, starting with the one after the suggester
+    std::vector<int> const & turnOrder = deck_->turnOrder;
+    std::vector<int>         responders;
+    size_t                   position = std::find(turnOrder.begin(), turnOrder.end(), suggester) - turnOrder.begin();
+    for (size_t i = 1; i < turnOrder.size(); ++i)
+    {
+        responders.push_back(turnOrder[(position + i) % turnOrder.size()]);
+    }
+
+    // Each worker takes the next candidate until there are none left. The generator used for a candidate depends only
+    // on the candidate, so the results don't depend on the number of workers.
+    double              before = answerUncertainty();
+    std::vector<double> gains(candidates.size());
+    std::atomic<size_t> next(0);
+    auto                work = [&] () {
+        for (size_t i = next++; i < candidates.size(); i = next++)
+        {
+            std::seed_seq   seed{ options.seed, (uint64_t)i };
+            std::mt19937_64 rng(seed);
+            gains[i] = before - expectedAnswerUncertainty(suggester, responders, candidates[i], deals, rng);
+        }
+    };
+
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    threads     = std::min(threads, (int)candidates.size());
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto & w : workers)
+    {
+        w.join();
+    }
+
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) { return gains[a] > gains[b]; });
+
+    AdviceList advice;
+    for (size_t i = 0; i < order.size() && (int)advice.size() < options.count; ++i)
+    {
+        Advice a;
+        for (auto c : candidates[order[i]])
+        {
+            a.cards.push_back(deck_->cards[c].id);
+        }
+        a.gain = gains[order[i]];
+        advice.push_back(a);
+    }
+    return advice;
 }
 
 json Solver::toJson() const
 {
     json j;
-    j["cards"]       = ::toJson(cards_);
-    j["players"]     = ::toJson(players_);
-    j["suggestions"] = ::toJson(suggestions_);
+
+    json cards;
+    for (size_t c = 0; c < cards_.size(); ++c)
+    {
+        cards[deck_->cards[c].id] = cards_[c].toJson(*this);
+    }
+    j["cards"] = cards;
+
+    json players;
+    for (size_t p = 0; p < players_.size(); ++p)
+    {
+        players[deck_->players[p]] = players_[p].toJson(*this);
+    }
+    j["players"] = players;
+
+    json suggestions = json::array();
+    for (size_t s = 0; s < suggestions_.size(); ++s)
+    {
+        suggestions.push_back(suggestions_[s].toJson(*this));
+    }
+    j["suggestions"] = suggestions;
     return j;
 }
 
+std::string Solver::snapshot(bool history /*= true*/) const
+{
+    SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.byteOrder   = SNAPSHOT_BYTE_ORDER;
+    header.version     = SNAPSHOT_VERSION;
+    header.deck        = deck_->hash;
+    header.players     = (uint8_t)players_.size();
+    header.cards       = (uint8_t)cards_.size();
+    header.types       = (uint8_t)deck_->types.size();
+    header.flags       = (history ? SNAPSHOT_HISTORY : 0) | (fullInference_ ? SNAPSHOT_FULL_INFERENCE : 0);
+    header.suggestions = (uint32_t)suggestions_.size();
+    header.showers     = (uint32_t)showerPlayers_.size();
+    header.accusations = (uint32_t)accusations_.size();
+    header.changes     = history ? (uint32_t)changes_.size() : 0;
+    header.marks       = history ? (uint32_t)marks_.size() : 0;
+
+    std::string out;
+    put(out, header);
+    for (auto p : deck_->turnOrder)
+    {
+        Id const & id = deck_->players[p];
+        put(out, (uint16_t)id.size());
+        out += id;
+    }
+    for (auto const & p : players_)
+    {
+        put(out, p.possible);
+        put(out, (int32_t)p.minCards);
+        put(out, (int32_t)p.maxCards);
+    }
+    for (auto const & c : cards_)
+    {
+        put(out, c.possible);
+    }
+    out.append((char const *)facts_.data(), facts_.size() * sizeof(Fact));
+    out.append((char const *)showerCards_.data(), showerCards_.size() * sizeof(Mask));
+    for (size_t i = 0; i < suggestions_.size(); ++i)
+    {
+        Suggestion const & s = suggestions_[i];
+        put(out, (int32_t)s.id);
+        put(out, (uint8_t)s.player);
+        put(out, (uint8_t)s.cards.size());
+        put(out, (uint8_t)s.showed.size());
+        for (auto c : s.cards)
+        {
+            put(out, (uint8_t)c);
+        }
+        for (auto p : s.showed)
+        {
+            put(out, (uint8_t)p);
+        }
+    }
+    for (size_t i = 0; i < accusations_.size(); ++i)
+    {
+        Accusation const & a = accusations_[i];
+        put(out, (int32_t)a.id);
+        put(out, (uint8_t)a.player);
+        put(out, (uint8_t)a.cards.size());
+        put(out, (uint8_t)a.correct);
+        put(out, (uint8_t)(nextBit(activeAccusations_, (int)i) == (int)i));
+        for (auto c : a.cards)
+        {
+            put(out, (uint8_t)c);
+        }
+    }
+    if (history)
+    {
+        out.append((char const *)changes_.data(), changes_.size() * sizeof(Change));
+        for (auto const & m : marks_)
+        {
+            put(out, (uint32_t)m.changes);
+            put(out, (uint32_t)m.suggestions);
+            put(out, (uint32_t)m.showers);
+            put(out, (uint32_t)m.accusations);
+            put(out, (uint8_t)m.settled);
+        }
+    }
+    return out;
+}
+
+Solver Solver::restore(Rules const & rules, void const * data, size_t size)
+{
+    SnapshotReader in(data, size);
+    SnapshotHeader header = in.get<SnapshotHeader>();
+    check(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+          header.byteOrder == SNAPSHOT_BYTE_ORDER &&
+          header.version == SNAPSHOT_VERSION &&
+          (header.flags & ~(SNAPSHOT_HISTORY | SNAPSHOT_FULL_INFERENCE)) == 0);
+    if (header.deck != deckHash(rules))
+        throw std::domain_error("The snapshot does not match the rules");
+
+    IdList playerIds;
+    for (int i = 0; i + 1 < header.players; ++i)
+    {
+        Id id(in.get<uint16_t>(), '\0');
+        in.read(&id[0], id.size());
+        playerIds.push_back(id);
+    }
+    IdList sorted = playerIds;
+    std::sort(sorted.begin(), sorted.end());
+    check(header.players >= 1 &&
+          std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end() &&
+          std::find(sorted.begin(), sorted.end(), ANSWER_PLAYER_ID) == sorted.end());
+
+    Solver solver(rules, playerIds);
+    int    players = (int)solver.players_.size();
+    int    cards   = (int)solver.cards_.size();
+    check(header.players == players && header.cards == cards && header.types == solver.deck_->types.size());
+    Mask allPlayers = (players < 64) ? bit(players) - 1 : ~Mask(0);
+    Mask allCards   = (cards < 64) ? bit(cards) - 1 : ~Mask(0);
+
+    for (auto & p : solver.players_)
+    {
+        p.possible = in.get<Mask>();
+        p.minCards = in.get<int32_t>();
+        p.maxCards = in.get<int32_t>();
+        check((p.possible & ~allCards) == 0 && 0 <= p.minCards && p.minCards <= p.maxCards && p.maxCards <= cards);
+    }
+    for (auto & c : solver.cards_)
+    {
+        c.possible = in.get<Mask>();
+        check((c.possible & ~allPlayers) == 0);
+    }
+    solver.answerHeld_ = solver.heldBy(solver.answer_, solver.players_[solver.answer_].possible);
+    in.read(solver.facts_.data(), solver.facts_.size() * sizeof(Fact));
+    for (auto f : solver.facts_)
+    {
+        check(f <= DOES_NOT_HOLD);
+    }
+
+    check(header.showers <= in.remaining() / sizeof(Mask));
+    std::vector<Mask> showerCards(header.showers);
+    in.read(showerCards.data(), showerCards.size() * sizeof(Mask));
+    for (uint32_t i = 0; i < header.suggestions; ++i)
+    {
+        Suggestion s;
+        s.id     = in.get<int32_t>();
+        s.player = in.get<uint8_t>();
+        s.cards.resize(in.get<uint8_t>());
+        s.showed.resize(in.get<uint8_t>());
+        for (auto & c : s.cards)
+        {
+            c = in.get<uint8_t>();
+            check(c < cards);
+        }
+        for (auto & p : s.showed)
+        {
+            p = in.get<uint8_t>();
+            check(p < players);
+        }
+        check(s.player < players);
+        s.cardMask   = solver.toMask(s.cards);
+        s.showedMask = solver.toMask(s.showed);
+        solver.addSuggestion(s);
+    }
+    check(solver.showerCards_.size() == showerCards.size());
+    for (size_t i = 0; i < showerCards.size(); ++i)
+    {
+        check(showerCards[i] == 0 || showerCards[i] == solver.showerCards_[i]);
+        solver.showerCards_[i] = showerCards[i];
+        solver.showerSeen_[i]  = solver.players_[solver.showerPlayers_[i]].possible & showerCards[i];
+    }
+
+    for (uint32_t i = 0; i < header.accusations; ++i)
+    {
+        Accusation a;
+        a.id     = in.get<int32_t>();
+        a.player = in.get<uint8_t>();
+        a.cards.resize(in.get<uint8_t>());
+        a.correct   = in.get<uint8_t>() != 0;
+        bool active = in.get<uint8_t>() != 0;
+        for (auto & c : a.cards)
+        {
+            c = in.get<uint8_t>();
+            check(c < cards);
+        }
+        check(a.player < players && !(a.correct && active));
+        a.cardMask = solver.toMask(a.cards);
+        solver.addAccusation(a);
+        if (!active)
+            clearBit(solver.activeAccusations_, (int)i);
+    }
+
+    solver.fullInference_ = (header.flags & SNAPSHOT_FULL_INFERENCE) != 0;
+    if (header.flags & SNAPSHOT_HISTORY)
+    {
+        check(header.changes <= in.remaining() / sizeof(Change));
+        solver.changes_.resize(header.changes);
+        in.read(solver.changes_.data(), solver.changes_.size() * sizeof(Change));
+        for (auto const & c : solver.changes_)
+        {
+            switch (c.kind)
+            {
+                case Change::CELL:
+                    check(c.player < players && c.card < cards);
+                    break;
+                case Change::FACT:
+                    check(0 <= c.index && c.index < players * cards);
+                    break;
+                case Change::HAND_SIZE:
+                    check(c.player < players && 0 <= c.index && c.index <= c.value && c.value <= cards);
+                    break;
+                case Change::SHOWER_CLOSED:
+                    check(0 <= c.index && c.index < (int)header.showers);
+                    break;
+                case Change::ACCUSATION_CLOSED:
+                    check(0 <= c.index && c.index < (int)header.accusations);
+                    break;
+                default:
+                    check(false);
+            }
+        }
+
+        Mark previous = { 0, 0, 0, 0, true };
+        for (uint32_t i = 0; i < header.marks; ++i)
+        {
+            Mark m;
+            m.changes     = in.get<uint32_t>();
+            m.suggestions = in.get<uint32_t>();
+            m.showers     = in.get<uint32_t>();
+            m.accusations = in.get<uint32_t>();
+            m.settled     = in.get<uint8_t>() != 0;
+            check(previous.changes <= m.changes && m.changes <= header.changes &&
+                  previous.suggestions <= m.suggestions && m.suggestions <= header.suggestions &&
+                  previous.showers <= m.showers && m.showers <= header.showers &&
+                  previous.accusations <= m.accusations && m.accusations <= header.accusations);
+            solver.marks_.push_back(m);
+            previous = m;
+        }
+        check(solver.marks_.empty() || solver.marks_.back().settled);
+    }
+    check(in.remaining() == 0);
+    return solver;
+}
+
 bool Solver::playersAreValid(IdList const & playerIds) const
 {
     for (auto const & p : playerIds)
@@ -137,7 +968,7 @@ bool Solver::playersAreValid(IdList const & playerIds) const
 
 bool Solver::playerIsValid(Id const & playerId) const
 {
-    return playerId != ANSWER_PLAYER_ID && players_.find(playerId) != players_.end();
+    return findPlayer(playerId) >= 0;
 }
 
 bool Solver::cardsAreValid(IdList const & cardIds) const
@@ -152,56 +983,36 @@ bool Solver::cardsAreValid(IdList const & cardIds) const
 
 bool Solver::cardIsValid(Id const & cardId) const
 {
-    return cards_.find(cardId) != cards_.end();
+    return findCard(cardId) >= 0;
 }
 
 bool Solver::typeIsValid(Id const & typeId) const
 {
-    return types_.find(typeId) != types_.end();
-}
-
-// If the player must hold one of the cards, but we know it doesn't hold all but one, then that one must be the one that is held
-bool Solver::mustHoldOne(Id const & playerId, IdList const & cardIds, Id & held)
-{
-    int count = 0;
-    for (auto const & cardId : cardIds)
-    {
-        if (players_[playerId].mightHold(cardId))
-        {
-            if (++count > 1)
-                return false;
-            held = cardId;
-        }
-    }
-    return true;
+    return deck_->typeTable->find(typeId) >= 0;
 }
 
-// If the player must not hold one of the cards, but we know it holds all but one, then that one is the one it doesn't hold
-bool Solver::mustNotHoldOne(Id const & playerId, IdList const & cardIds, Id & notHeld)
+// If the player must hold one of the cards, but we know it doesn't hold all but one, then that one must be the one that is held
+bool Solver::mustHoldOne(int player, Mask cards, int & held) const
 {
-    int count = 0;
-    for (auto const & cardId : cardIds)
-    {
-        if (!cards_[cardId].isHeldBy(playerId))
-        {
-            if (++count > 1)
-                return false;
-            notHeld = cardId;
-        }
-    }
+    Mask possible = players_[player].possible & cards;
+    if (countBits(possible) != 1)
+        return false;
+    held = lowestBit(possible);
     return true;
 }
 
-void Solver::deduce(Suggestion const & suggestion, bool & changed)
+// If the player must not hold one of the cards, but we know it holds all but one, then that one is the one it doesn't hold
+bool Solver::mustNotHoldOne(int player, Mask cards, int & notHeld) const
 {
-    if (rulesId_ == "master")
-        deduceWithMasterRules(suggestion, changed);
-    else
-        deduceWithClassicRules(suggestion, changed);
+    Mask notKnownHeld = cards & ~heldBy(player, cards);
+    if (countBits(notKnownHeld) != 1)
+        return false;
+    notHeld = lowestBit(notKnownHeld);
+    return true;
 }
 
 // Make deductions based on the results of this accusation
-void Solver::deduce(Accusation const & accusation, bool & changed)
+void Solver::deduceFromAccusation(int index, bool & changed)
 {
     // You can deduce from an accusation that :
     //    The accuser does not have the cards in the accusation (assuming no suicidal intentions).
@@ -210,67 +1021,81 @@ void Solver::deduce(Accusation const & accusation, bool & changed)
     //      At least one of the cards is not held by the answer, but if we know that two of the cards are held by the answer,
     //      then the third is not held
 
-    int            id      = accusation.id;
-    Id const &     accuser = accusation.player;
-    IdList const & cards   = accusation.cards;
-    bool           correct = accusation.correct;
+    Accusation const & accusation = accusations_[index];
+    int                id         = accusation.id;
+    int                accuser    = accusation.player;
+    Mask               cards      = accusation.cardMask;
+    bool               correct    = accusation.correct;
 
-    addDiscoveries(accuser, cards, false, "made accusation #" + std::to_string(id));
+    addDiscoveries(accuser, accusation.cards, false, Discovery::MADE_ACCUSATION, id);
     disassociatePlayerWithCards(accuser, cards, changed);
 
     if (correct)
     {
-        for (auto const & card : cards)
+        for (auto card : accusation.cards)
         {
-            associatePlayerWithCard(ANSWER_PLAYER_ID, card, changed);
+            associatePlayerWithCard(answer_, card, changed);
         }
     }
     else
     {
-        Id mustNotHold;
-        if (mustNotHoldOne(ANSWER_PLAYER_ID, cards, mustNotHold))
-        {
-            addDiscovery(ANSWER_PLAYER_ID, mustNotHold, false, "holds the other cards in accusation #" + std::to_string(id));
-            disassociatePlayerWithCard(ANSWER_PLAYER_ID, mustNotHold, changed);
-        }
+        deduceFromIncorrectAccusation(index, changed);
     }
 }
 
-// Make deductions based on the player having exactly these cards
-void Solver::deduce(Id const & playerId, IdList const & cards, bool & changed)
+// If the answer holds all but one of the cards in an incorrect accusation, then it does not hold the one
+void Solver::deduceFromIncorrectAccusation(int index, bool & changed)
 {
-    Player & player = players_[playerId];
+    Accusation const & accusation = accusations_[index];
+    assert(!accusation.correct);
+    int mustNotHold;
+    if (mustNotHoldOne(answer_, accusation.cardMask, mustNotHold))
+    {
+        addDiscovery(answer_, mustNotHold, false, Discovery::HOLDS_OTHER_ACCUSED_CARDS, accusation.id);
+        disassociatePlayerWithCard(answer_, mustNotHold, changed);
+    }
+
+    // Once the answer is known to not hold one of the cards, nothing more can be deduced
+    if ((players_[answer_].possible & accusation.cardMask) != accusation.cardMask)
+    {
+        changes_.push_back({ Change::ACCUSATION_CLOSED, 0, 0, 0, index });
+        clearBit(activeAccusations_, index);
+    }
+}
 
+// Make deductions based on the player having exactly these cards
+void Solver::deduce(int player, Mask cards, bool & changed)
+{
     // Associate the player with every card in the list and disassociate the player with every other card.
-    for (auto & c : cards_)
+    for (int c = 0; c < (int)cards_.size(); ++c)
     {
-        if (std::find(cards.begin(), cards.end(), c.first) != cards.end())
+        if (cards & bit(c))
         {
-            addDiscovery(playerId, c.first, true, "hand");
-            associatePlayerWithCard(playerId, c.first, changed);
+            addDiscovery(player, c, true, Discovery::HAND);
+            associatePlayerWithCard(player, c, changed);
         }
         else
         {
-            addDiscovery(playerId, c.first, false, "hand");
-            disassociatePlayerWithCard(playerId, c.first, changed);
+            addDiscovery(player, c, false, Discovery::HAND);
+            disassociatePlayerWithCard(player, c, changed);
         }
     }
 }
 
-// Make deductions based on the player having this cardId
-void Solver::deduce(Id const & playerId, Id const & cardId, bool & changed)
+// Make deductions based on the player having this card
+void Solver::deduce(int player, int card, bool & changed)
 {
-    addDiscovery(playerId, cardId, true, "revealed");
-    associatePlayerWithCard(playerId, cardId, changed);
+    addDiscovery(player, card, true, Discovery::REVEALED);
+    associatePlayerWithCard(player, card, changed);
 }
 
 void Solver::deduceWithClassicRules(Suggestion const & suggestion, bool & changed)
 {
-    assert(rulesId_ == "classic");
-    int            id        = suggestion.id;
-    Id const &     suggester = suggestion.player;
-    IdList const & cards     = suggestion.cards;
-    IdList const & showed    = suggestion.showed;
+    assert(!master_);
+    int                      id        = suggestion.id;
+    int                      suggester = suggestion.player;
+    std::vector<int> const & cards     = suggestion.cards;
+    std::vector<int> const & showed    = suggestion.showed;
 
     // You can deduce from a suggestion that:
     //		If nobody showed a card, then none of the players (except possibly the suggester or the answer) have the cards.
@@ -279,13 +1104,12 @@ void Solver::deduceWithClassicRules(Suggestion const & suggestion, bool & change
 
     if (showed.empty())
     {
-        for (auto const & p : players_)
+        for (int p = 0; p < (int)players_.size(); ++p)
         {
-            Id const & playerId = p.first;
-            if (playerId != ANSWER_PLAYER_ID && playerId != suggester)
+            if (p != answer_ && p != suggester)
             {
-                addDiscoveries(playerId, cards, false, "did not show a card in suggestion #" + std::to_string(id));
-                disassociatePlayerWithCards(playerId, suggestion.cards, changed);
+                addDiscoveries(p, cards, false, Discovery::DID_NOT_SHOW, id);
+                disassociatePlayerWithCards(p, suggestion.cardMask, changed);
             }
         }
     }
@@ -294,115 +1118,283 @@ void Solver::deduceWithClassicRules(Suggestion const & suggestion, bool & change
         // All but the last player have none of the cards
         for (size_t i = 0; i < showed.size() - 1; ++i)
         {
-            Id const & playerId = showed[i];
-            for (auto const & c : cards)
-            {
-                addDiscovery(playerId, c, false, "did not show a card in suggestion #" + std::to_string(id));
-            }
-            disassociatePlayerWithCards(playerId, suggestion.cards, changed);
+            addDiscoveries(showed[i], cards, false, Discovery::DID_NOT_SHOW, id);
+            disassociatePlayerWithCards(showed[i], suggestion.cardMask, changed);
         }
 
         // The last player showed a card.
-        {
-            // If the player does not hold all but one of cards, the player must hold the one.
-            Id const &     playerId       = showed[showed.size() - 1];
-            Player const & player         = players_[playerId];
-            int            mightHoldCount = 0;
-            Id             mustHold;
-            for (auto const & c : cards)
-            {
-                if (player.mightHold(c))
-                {
-                    ++mightHoldCount;
-                    if (mightHoldCount == 1)
-                        mustHold = c;   // Assuming none of the others are held
-                    else
-                        break;          // Optimization
-                }
-            }
-            assert(mightHoldCount >= 1);
-            if (mightHoldCount == 1)
-            {
-                addDiscovery(playerId,
-                             mustHold,
-                             true,
-                             "showed a card in suggestion #" + std::to_string(id) + ", and does not hold the others");
-                associatePlayerWithCard(playerId, mustHold, changed);
-            }
-        }
+        deduceFromShower(suggestion, showed.back(), changed);
     }
 }
 
 void Solver::deduceWithMasterRules(Suggestion const & suggestion, bool & changed)
 {
-    assert(rulesId_ == "master");
-    int            id        = suggestion.id;
-    Id const &     suggester = suggestion.player;
-    IdList const & cards     = suggestion.cards;
-    IdList const & showed    = suggestion.showed;
+    assert(master_);
+    int                      id        = suggestion.id;
+    int                      suggester = suggestion.player;
+    std::vector<int> const & cards     = suggestion.cards;
 
     // You can deduce from a suggestion that:
     //		If a player shows a card but does not all but one of the suggested cards, the player must hold the one.
     //		If a player (other than the answer and suggester) does not show a card, the player has none of the suggested cards.
     //		If all suggested cards are shown, then the answer and the suggester hold none of the suggested cards.
 
-    for (auto const & p : players_)
+    for (int p = 0; p < (int)players_.size(); ++p)
     {
-        Id const &     playerId = p.first;
-        Player const & player   = p.second;
-
         // If the player showed a card ...
-        if (std::find(showed.begin(), showed.end(), playerId) != showed.end())
+        if (suggestion.showedMask & bit(p))
         {
-            // ..., then if the player does not hold all but one of the cards, the player must hold the one.
-            int mightHoldCount = 0;
-            Id  mustHold;
-            for (auto const & c : cards)
-            {
-                if (player.mightHold(c))
-                {
-                    ++mightHoldCount;
-                    if (mightHoldCount == 1)
-                        mustHold = c;   // Assuming none of the others are held
-                    else
-                        break;          // Optimization
-                }
-            }
-            assert(mightHoldCount >= 1);
-            if (mightHoldCount == 1)
-            {
-                addDiscovery(playerId,
-                             mustHold,
-                             true,
-                             "showed a card in suggestion #" + std::to_string(id) + ", and does not hold the others");
-                associatePlayerWithCard(playerId, mustHold, changed);
-            }
+            deduceFromShower(suggestion, p, changed);
         }
 
         // Otherwise, if the player is other than the answer and suggester ...
-        else if (playerId != ANSWER_PLAYER_ID && playerId != suggester)
+        else if (p != answer_ && p != suggester)
         {
             // ... then they don't hold any of them.
-            for (auto const & c : cards)
-            {
-                addDiscovery(playerId, c, false, "did not show a card in suggestion #" + std::to_string(id));
-            }
-            disassociatePlayerWithCards(playerId, suggestion.cards, changed);
+            addDiscoveries(p, cards, false, Discovery::DID_NOT_SHOW, id);
+            disassociatePlayerWithCards(p, suggestion.cardMask, changed);
         }
 
         // Otherwise, if all three cards were shown ...
-        else if (showed.size() == 3)
+        else if (suggestion.showed.size() == 3)
         {
             // ... then players that don't show cards don't hold them.
-            // ... then they don't hold any of them.
-            for (auto const & c : cards)
-            {
-                addDiscovery(playerId,
-                             c,
-                             false,
-                             "all three cards were shown by other players in suggestion #" + std::to_string(id));
-            }
-            disassociatePlayerWithCards(playerId, suggestion.cards, changed);
+            addDiscoveries(p, cards, false, Discovery::ALL_CARDS_SHOWN, id);
+            disassociatePlayerWithCards(p, suggestion.cardMask, changed);
+        }
+    }
+}
+
+// If the player showed a card but does not hold all but one of the cards, the player must hold the one
+void Solver::deduceFromShower(Suggestion const & suggestion, int player, bool & changed)
+{
+    assert((players_[player].possible & suggestion.cardMask) != 0);
+    int shower = suggestion.firstShower + countBits(suggestion.showers & (bit(player) - 1));
+    int mustHold;
+    if (mustHoldOne(player, suggestion.cardMask, mustHold))
+    {
+        addDiscovery(player, mustHold, true, Discovery::SHOWED_ONLY_POSSIBLE_CARD, suggestion.id);
+        associatePlayerWithCard(player, mustHold, changed);
+    }
+
+    // Once the player is known to hold one of the cards, nothing more can be deduced from what the player showed
+    if (heldBy(player, suggestion.cardMask) != 0)
+    {
+        changes_.push_back({ Change::SHOWER_CLOSED, 0, 0, 0, shower });
+        showerCards_[shower] = 0;
+        showerSeen_[shower]  = 0;
+    }
+}
+
+// Returns the index of the first shower at or after start that needs to be re-examined, or -1 if there are none
+int Solver::nextChangedShower(int start) const
+{
+    static_assert(sizeof(Player) % sizeof(Mask) == 0, "The possible cards are gathered in units of masks");
+    return findChangedShower(&players_[0].possible,
+                             (int)(sizeof(Player) / sizeof(Mask)),
+                             showerPlayers_.data(),
+                             showerCards_.data(),
+                             showerSeen_.data(),
+                             start,
+                             (int)showerPlayers_.size());
+}
+
+// Adds a suggestion and its showers. Only the players that showed a card are needed in the suggestion.
+void Solver::addSuggestion(Suggestion const & suggestion)
+{
+    Suggestion s = suggestion;
+    if (master_)
+        s.showers = s.showedMask;
+    else
+        s.showers = s.showed.empty() ? 0 : bit(s.showed.back());
+    s.firstShower = (int)showerPlayers_.size();
+    forEachBit(s.showers, [&] (int p) {
+        showerPlayers_.push_back(p);
+        showerSuggestions_.push_back((int)suggestions_.size());
+        showerCards_.push_back(s.cardMask);
+        showerSeen_.push_back(players_[p].possible & s.cardMask);
+    });
+    suggestions_.push_back(s);
+}
+
+// Adds an accusation. More can be deduced from an incorrect accusation as the answer's cards become known.
+void Solver::addAccusation(Accusation const & accusation)
+{
+    int index = (int)accusations_.size();
+    accusations_.push_back(accusation);
+    if (!accusation.correct)
+    {
+        accusedCards_ |= accusation.cardMask;
+        setBit(activeAccusations_, index);
+    }
+}
+
+// Starts recording the changes made by a new event
+void Solver::beginEvent()
+{
+    discoveriesLog_.clear();
+    marks_.push_back({ changes_.size(), suggestions_.size(), showerPlayers_.size(), accusations_.size(), true });
+}
+
+// Records a player's hand and makes the deductions it allows directly
+void Solver::recordHand(int player, std::vector<int> const & cards, bool & changed)
+{
+    assert(player >= 0 && player < (int)players_.size());
+    changes_.push_back({ Change::HAND_SIZE, (uint8_t)player, 0, (uint8_t)players_[player].maxCards, players_[player].minCards });
+    players_[player].minCards = (int)cards.size();
+    players_[player].maxCards = (int)cards.size();
+
+    deduce(player, toMask(cards), changed);
+}
+
+// Records a card being revealed by a player
+void Solver::recordShow(int player, int card, bool & changed)
+{
+    assert(player >= 0 && player < (int)players_.size());
+    assert(card >= 0 && card < (int)cards_.size());
+    deduce(player, card, changed);
+}
+
+// Records a suggestion and makes the deductions it allows directly
+void Solver::recordSuggestion(int                      player,
+                              std::vector<int> const & cards,
+                              std::vector<int> const & showed,
+                              int                      id,
+                              bool &                   changed)
+{
+    assert(player >= 0 && player < (int)players_.size());
+    Suggestion suggestion;
+    suggestion.id         = id;
+    suggestion.player     = player;
+    suggestion.cards      = cards;
+    suggestion.cardMask   = toMask(suggestion.cards);
+    suggestion.showed     = showed;
+    suggestion.showedMask = toMask(suggestion.showed);
+    addSuggestion(suggestion);
+
+    (this->*deduceFrom_)(suggestions_.back(), changed);
+}
+
+// Records an accusation and makes the deductions it allows directly
+void Solver::recordAccusation(int player, std::vector<int> const & cards, bool outcome, int id, bool & changed)
+{
+    assert(player >= 0 && player < (int)players_.size());
+    Accusation accusation;
+    accusation.id       = id;
+    accusation.player   = player;
+    accusation.cards    = cards;
+    accusation.cardMask = toMask(accusation.cards);
+    accusation.correct  = outcome;
+    addAccusation(accusation);
+
+    deduceFromAccusation((int)accusations_.size() - 1, changed);
+}
+
+// Reverts the changes made by the latest event in reverse order, and then removes what it added
+void Solver::undoLatestEvent()
+{
+    Mark mark = marks_.back();
+    marks_.pop_back();
+
+    while (changes_.size() > mark.changes)
+    {
+        Change const & change = changes_.back();
+        switch (change.kind)
+        {
+            case Change::CELL:
+                players_[change.player].possible |= bit(change.card);
+                cards_[change.card].possible |= bit(change.player);
+                if (cards_[change.card].isHeldBy(answer_))
+                    answerHeld_ |= bit(change.card);
+                else
+                    answerHeld_ &= ~bit(change.card);
+                break;
+            case Change::FACT:
+                facts_[change.index] = UNKNOWN;
+                break;
+            case Change::HAND_SIZE:
+                players_[change.player].minCards = change.index;
+                players_[change.player].maxCards = change.value;
+                break;
+            case Change::SHOWER_CLOSED:
+                showerCards_[change.index] = suggestions_[showerSuggestions_[change.index]].cardMask;
+                break;
+            case Change::ACCUSATION_CLOSED:
+                setBit(activeAccusations_, change.index);
+                break;
+        }
+        changes_.pop_back();
+    }
+
+    if (accusations_.size() > mark.accusations)
+    {
+        for (size_t a = mark.accusations; a < accusations_.size(); ++a)
+        {
+            clearBit(activeAccusations_, (int)a);
+        }
+        accusations_.truncate(mark.accusations);
+        accusedCards_ = 0;
+        for (size_t a = 0; a < accusations_.size(); ++a)
+        {
+            if (!accusations_[a].correct)
+                accusedCards_ |= accusations_[a].cardMask;
+        }
+    }
+    suggestions_.truncate(mark.suggestions);
+    showerPlayers_.resize(mark.showers);
+    showerSuggestions_.resize(mark.showers);
+    showerCards_.resize(mark.showers);
+    showerSeen_.resize(mark.showers);
+
+    // Between events, every shower has been examined since its player's cards last changed
+    for (size_t i = 0; i < showerPlayers_.size(); ++i)
+    {
+        showerSeen_[i] = players_[showerPlayers_[i]].possible & showerCards_[i];
+    }
+}
+
+// Makes the deductions that were left to a later event in the latest event's batch, after that event has been undone.
+// What they depend on is not known, so everything is re-examined as if it had all changed. The changes are recorded as
+// the latest event's.
+void Solver::settleLatestEvent()
+{
+    for (size_t i = 0; i < showerPlayers_.size(); ++i)
+    {
+        showerSeen_[i] = ~(players_[showerPlayers_[i]].possible & showerCards_[i]);
+    }
+    dirtyAccusations_ = activeAccusations_;
+    dirtyCards_       = (cards_.size() < 64) ? bit((int)cards_.size()) - 1 : ~Mask(0);
+    answerTypes_      = bit((int)deck_->types.size()) - 1;
+    makeOtherDeductions(true);
+    marks_.back().settled = true;
+}
+
+// Marks everything that depends on the cell as needing to be re-examined, except the showers, which are checked
+// directly. There are few accusations, so the ones with the card are found by checking them all.
+void Solver::cellChanged(int player, int card)
+{
+    dirtyCards_ |= bit(card);
+
+    // The answer holds one card of each type, so there is something to deduce about a type only when the answer might
+    // hold just one of its cards, or is found to hold one of them
+    int type = deck_->cards[card].type;
+    if (player == answer_)
+    {
+        if (countBits(players_[answer_].possible & deck_->types[type].cards) == 1)
+            answerTypes_ |= bit(type);
+    }
+    else if (cards_[card].isHeldBy(answer_))
+    {
+        answerHeld_ |= bit(card);
+        answerTypes_ |= bit(type);
+    }
+
+    if (accusedCards_ & bit(card))
+    {
+        for (int a = nextBit(activeAccusations_, 0); a >= 0; a = nextBit(activeAccusations_, a + 1))
+        {
+            if (accusations_[a].cardMask & bit(card))
+                setBit(dirtyAccusations_, a);
         }
     }
 }
@@ -411,230 +1403,596 @@ bool Solver::makeOtherDeductions(bool changed)
 {
     addCardHoldersToDiscoveries();
     checkThatAnswerHoldsExactlyOneOfEach(changed);
+    if (!changed)
+        inferRemainingFacts(changed);
 
-    // Re-apply all the suggestions and accusations until knowledge has not changed
+    // Re-examine the suggestions and accusations affected by the changes until knowledge has not changed. Those
+    // affected by changes made during a pass are re-examined in the same pass if they come later, as if every
+    // suggestion and accusation were re-applied in order.
     while (changed)
     {
+        ++statistics_.passes;
         changed = false;
-        for (auto & s : suggestions_)
+        for (int i = nextChangedShower(0); i >= 0;)
         {
-            deduce(s, changed);
+            // All the showers of the suggestion are re-examined, and any changes made while doing so are seen the next
+            // time the showers are checked
+            Suggestion const & s     = suggestions_[showerSuggestions_[i]];
+            int                first = s.firstShower;
+            int                last  = first + countBits(s.showers);
+            for (int j = first; j < last; ++j)
+            {
+                showerSeen_[j] = players_[showerPlayers_[j]].possible & showerCards_[j];
+            }
+            for (int j = first; j < last; ++j)
+            {
+                if (showerCards_[j] != 0)
+                {
+                    ++statistics_.showersExamined;
+                    deduceFromShower(s, showerPlayers_[j], changed);
+                }
+            }
+            i = nextChangedShower(last);
         }
-        for (auto & a : accusations_)
+        for (int i = nextBit(dirtyAccusations_, 0); i >= 0; i = nextBit(dirtyAccusations_, i + 1))
         {
-            deduce(a, changed);
+            clearBit(dirtyAccusations_, i);
+            if (nextBit(activeAccusations_, i) == i)
+            {
+                ++statistics_.accusationsExamined;
+                deduceFromIncorrectAccusation(i, changed);
+            }
         }
         addCardHoldersToDiscoveries();
         checkThatAnswerHoldsExactlyOneOfEach(changed);
+
+        // Once the rules can deduce nothing more, full inference finds whatever they have missed
+        if (!changed)
+            inferRemainingFacts(changed);
     }
     addCardHoldersToDiscoveries();
     return changed;
 }
 
+// Removes every card from a player that the player does not hold in any deal consistent with everything known, if full
+// inference is on. The clause engine is brought up to date with the constraints first, or rebuilt if events have been
+// undone since it was last used.
+void Solver::inferRemainingFacts(bool & changed)
+{
+    if (!fullInference_)
+        return;
+
+    Constraints c = constraints();
+    if (!engine_)
+    {
+        engine_ = std::make_shared<ClauseEngine>(c);
+    }
+    else
+    {
+        // A copy of the solver may be using the same engine
+        if (engine_.use_count() > 1)
+            engine_ = std::make_shared<ClauseEngine>(*engine_);
+        if (!engine_->update(c))
+            engine_ = std::make_shared<ClauseEngine>(c);
+    }
+
+    std::vector<Mask> excluded = engine_->excluded();
+    for (int p = 0; p < (int)excluded.size(); ++p)
+    {
+        forEachBit(excluded[p], [&] (int card) {
+            addDiscovery(p, card, false, Discovery::NO_CONSISTENT_DEAL);
+            disassociatePlayerWithCard(p, card, changed);
+        });
+    }
+}
+
 void Solver::checkThatAnswerHoldsExactlyOneOfEach(bool & changed)
 {
-    Player & answer = players_[ANSWER_PLAYER_ID];
+    // Only the types in which the answer might now hold just one card, or is now known to hold one, need to be checked
+    Mask types   = answerTypes_;
+    answerTypes_ = 0;
+
+    Player const & answer = players_[answer_];
+    Mask           held   = answerHeld_;
 
     // Remove any possible cards that are of the same type as cards known to be held by the answer
     {
-        // Get a list of the cards known to be held by the answer
-        std::map<Id, Id> held;
-        for (auto const & cardId : answer.possible)
-        {
-            Card const & card = cards_[cardId];
-            if (card.isHeldBy(ANSWER_PLAYER_ID))
+        Mask others = 0;
+        forEachBit(types, [&] (int t) {
+            if (held & deck_->types[t].cards)
+                others |= answer.possible & deck_->types[t].cards & ~held;
+        });
+
+        forEachBit(others, [&] (int c) {
+            addDiscovery(answer_, c, false, Discovery::ANSWER_HOLDS_ANOTHER_OF_TYPE);
+            disassociatePlayerWithCard(answer_, c, changed);
+        });
+    }
+
+    // For each type, if there is only one card that might be held by the answer, then that card must be held by the answer
+    {
+        Mask possible = answer.possible & ~held;
+        forEachBit(types, [&] (int t) {
+            int unique;
+            if (mustHoldOne(answer_, possible & deck_->types[t].cards, unique))
             {
-                Id const & type = card.info.type;
-                held[type] = cardId;
+                addDiscovery(answer_, unique, true, Discovery::ONLY_CARD_OF_TYPE_ANSWER_CAN_HOLD);
+                associatePlayerWithCard(answer_, unique, changed);
             }
-        }
+        });
+    }
+}
+
+void Solver::associatePlayerWithCard(int player, int card, bool & changed)
+{
+    Card const & c = cards_[card];
+    if (countBits(c.possible) == 1)
+    {
+        assert(c.possible == bit(player));
+        return;
+    }
+
+    disassociateOtherPlayersWithCard(player, card, changed);
+    changed = true;
+}
+
+void Solver::disassociatePlayerWithCard(int player, int card, bool & changed)
+{
+    Player & p = players_[player];
+    if (p.mightHold(card))
+    {
+        p.remove(card);
+        cards_[card].remove(player);
+        changes_.push_back({ Change::CELL, (uint8_t)player, (uint8_t)card, 0, 0 });
+        cellChanged(player, card);
+        changed = true;
+        addDiscovery(player, card, false, Discovery::UNLOGGED);
+    }
+}
+
+void Solver::disassociatePlayerWithCards(int player, Mask cards, bool & changed)
+{
+    forEachBit(cards & players_[player].possible, [&] (int c) {
+        disassociatePlayerWithCard(player, c, changed);
+    });
+}
+
+void Solver::disassociateOtherPlayersWithCard(int player, int card, bool & changed)
+{
+    forEachBit(cards_[card].possible & ~bit(player), [&] (int p) {
+        disassociatePlayerWithCard(p, card, changed);
+    });
+}
+
+// Returns the constraints on the deal implied by everything known so far
+Constraints Solver::constraints() const
+{
+    Constraints c;
+    c.answer = answer_;
+    for (auto const & p : players_)
+    {
+        c.possible.push_back(p.possible);
+        c.minCards.push_back(p.minCards);
+        c.maxCards.push_back(p.maxCards);
+    }
+    for (auto const & t : deck_->types)
+    {
+        c.types.push_back(t.cards);
+    }
+
+    // Every player that showed a card holds at least one of the suggested cards. The rest of what is known from the
+    // suggestions and accusations is already in the knowledge matrix.
+    for (size_t i = 0; i < showerPlayers_.size(); ++i)
+    {
+        c.holdsOneOf.push_back({ showerPlayers_[i], suggestions_[showerSuggestions_[i]].cardMask });
+    }
+    for (size_t i = 0; i < accusations_.size(); ++i)
+    {
+        if (!accusations_[i].correct)
+            c.answerNotAll.push_back(accusations_[i].cardMask);
+    }
+    return c;
+}
+
+// Returns the number of bits needed to identify the answer among the cards it might hold
+double Solver::answerUncertainty() const
+{
+    double bits = 0.0;
+    for (auto const & t : deck_->types)
+    {
+        int possible = countBits(players_[answer_].possible & t.cards);
+        if (possible > 1)
+            bits += std::log2((double)possible);
+    }
+    return bits;
+}
 
-        // Each type held by the answer, none of others of the same type can be held
-        IdList possible = answer.possible;    // Must use a copy because the list may be mutated on the fly
-        for (auto const & cardId : possible)
+// Returns the expected uncertainty of the answer after the suggestion. The deals are grouped by the response that the
+// suggester would see, and the suggestion and response are applied to a copy of the solver for each distinct response.
+double Solver::expectedAnswerUncertainty(int                                   suggester,
+                                         std::vector<int> const &              responders,
+                                         std::vector<int> const &              cards,
+                                         std::vector<std::vector<int>> const & deals,
+                                         std::mt19937_64 &                     rng) const
+{
+    // A response is the list of players that showed a card, each followed by the card shown
+    std::map<std::vector<int>, int> responses;
+    std::vector<int>                response;
+    for (auto const & holders : deals)
+    {
+        response.clear();
+        for (auto r : responders)
         {
-            for (auto const & h : held)
+            int held[MAX_CARDS];
+            int count = 0;
+            for (auto c : cards)
             {
-                if (cards_[cardId].info.type == h.first && cardId != h.second)
-                {
-                    addDiscovery(ANSWER_PLAYER_ID, cardId, false, "ANSWER can only hold one " + h.first);
-                    disassociatePlayerWithCard(ANSWER_PLAYER_ID, cardId, changed);
-                }
+                if (holders[c] == r)
+                    held[count++] = c;
+            }
+            if (count > 0)
+            {
+                response.push_back(r);
+                response.push_back(held[std::uniform_int_distribution<int>(0, count - 1)(rng)]);
+                if (!master_)
+                    break;  // Only the first player with a card shows one
             }
         }
+        ++responses[response];
     }
 
-    // For each type, if there is only one card that might be held by the answer, then that card must be held by the answer
+    IdList suggested;
+    for (auto c : cards)
+    {
+        suggested.push_back(deck_->cards[c].id);
+    }
+
+    double expected = 0.0;
+    for (auto const & r : responses)
     {
-        std::map<Id, Id> unique;
-        for (auto const & cardId : answer.possible)
+        // Under Classic rules, the players that had nothing are listed before the one that showed a card
+        IdList showed;
+        if (master_)
         {
-            Card const & card = cards_[cardId];
-            if (!card.isHeldBy(ANSWER_PLAYER_ID))
+            for (size_t i = 0; i < r.first.size(); i += 2)
             {
-                Id                         typeId = card.info.type;
-                std::map<Id, Id>::iterator i      = unique.find(typeId);
-                if (i == unique.end())
-                    unique.insert({ typeId, cardId }); // First card for this type
-                else
-                    i->second.clear(); // Not unique
+                showed.push_back(deck_->players[r.first[i]]);
             }
         }
-
-        // Any unique card of a type is now known to be held
-        for (auto const & u : unique)
+        else if (!r.first.empty())
         {
-            Id const & cardId = u.second;
-            if (cardId.length() > 0)
+            for (auto p : responders)
             {
-                addDiscovery(ANSWER_PLAYER_ID, cardId, true, "Only " + u.first + " that ANSWER can hold");
-                associatePlayerWithCard(ANSWER_PLAYER_ID, cardId, changed);
+                showed.push_back(deck_->players[p]);
+                if (p == r.first[0])
+                    break;
             }
         }
+
+        // The rules are enough to compare the suggestions
+        Solver hypothetical = fork();
+        hypothetical.setFullInference(false);
+        hypothetical.suggest(deck_->players[suggester], suggested, showed, (int)suggestions_.size());
+        for (size_t i = 0; i < r.first.size(); i += 2)
+        {
+            hypothetical.show(deck_->players[r.first[i]], deck_->cards[r.first[i + 1]].id);
+        }
+        expected += (double)r.second / (double)deals.size() * hypothetical.answerUncertainty();
     }
+    return expected;
+}
+
+// Returns the subset of the cards that are known to be held by the player
+Solver::Mask Solver::heldBy(int player, Mask cards) const
+{
+    Mask held = 0;
+    forEachBit(cards & players_[player].possible, [&] (int c) {
+        if (cards_[c].isHeldBy(player))
+            held |= bit(c);
+    });
+    return held;
 }
 
-void Solver::associatePlayerWithCard(Id const & playerId, Id const & cardId, bool & changed)
+Solver::Mask Solver::toMask(std::vector<int> const & indexes) const
 {
-    Card & c = cards_[cardId];
-    if (c.possible.size() == 1)
+    Mask m = 0;
+    for (auto i : indexes)
     {
-        assert(c.possible[0] == playerId);
-        return;
+        m |= bit(i);
     }
+    return m;
+}
 
-    disassociateOtherPlayersWithCard(playerId, cardId, changed);
-    changed = true;
+// Returns the index of a player (including the answer)
+int Solver::playerIndex(Id const & playerId) const
+{
+    int p = deck_->playerTable.find(playerId);
+    assert(p >= 0);
+    return p;
 }
 
-void Solver::disassociatePlayerWithCard(Id const & playerId, Id const & cardId, bool & changed)
+// Returns the index of a card
+int Solver::cardIndex(Id const & cardId) const
 {
-    Player & player = players_[playerId];
-    if (player.mightHold(cardId))
+    int c = deck_->cardTable->find(cardId);
+    assert(c >= 0);
+    return c;
+}
+
+// Returns the index of a card type
+int Solver::typeIndex(Id const & typeId) const
+{
+    int t = deck_->typeTable->find(typeId);
+    assert(t >= 0);
+    return t;
+}
+
+// Returns the index of a player that takes part in events, or -1
+int Solver::findPlayer(std::string_view playerId) const
+{
+    int p = deck_->playerTable.find(playerId);
+    return (p != answer_) ? p : -1;
+}
+
+std::vector<int> Solver::cardIndexes(IdList const & cardIds) const
+{
+    std::vector<int> indexes;
+    indexes.reserve(cardIds.size());
+    for (auto const & c : cardIds)
     {
-        player.remove(cardId);
-        cards_[cardId].remove(playerId);
-        changed = true;
-        addDiscovery(playerId, cardId, false);  // Add this discovery, but don't log it
+        indexes.push_back(cardIndex(c));
     }
+    return indexes;
 }
 
-void Solver::disassociatePlayerWithCards(Id const & playerId, IdList const & suggestion, bool & changed)
+std::vector<int> Solver::playerIndexes(IdList const & playerIds) const
 {
-    for (auto const & c : suggestion)
+    std::vector<int> indexes;
+    indexes.reserve(playerIds.size());
+    for (auto const & p : playerIds)
     {
-        disassociatePlayerWithCard(playerId, c, changed);
+        indexes.push_back(playerIndex(p));
     }
+    return indexes;
+}
+
+Solver::IdList Solver::cardIds(Mask cards) const
+{
+    IdList ids;
+    forEachBit(cards, [&] (int c) { ids.push_back(deck_->cards[c].id); });
+    return ids;
+}
+
+Solver::IdList Solver::playerIds(Mask players) const
+{
+    IdList ids;
+    forEachBit(players, [&] (int p) { ids.push_back(deck_->players[p]); });
+    return ids;
 }
 
-void Solver::disassociateOtherPlayersWithCard(Id const & playerId, Id const & cardId, bool & changed)
+std::string Solver::describe(Discovery const & discovery) const
 {
-    for (auto & p : players_)
+    Deck::CardDefinition const & card     = deck_->cards[discovery.card];
+    Type const &                 type     = deck_->types[card.type];
+    std::string                  text     = deck_->players[discovery.player] +
+                                            (discovery.holds ? " holds " : " does not hold ") + type.info.article +
+                                            card.info.name + ": ";
+    switch (discovery.reason)
     {
-        if (p.first != playerId)
-            disassociatePlayerWithCard(p.first, cardId, changed);
+        case Discovery::UNLOGGED:
+            break;
+        case Discovery::HAND:
+            text += "hand";
+            break;
+        case Discovery::REVEALED:
+            text += "revealed";
+            break;
+        case Discovery::MADE_ACCUSATION:
+            text += "made accusation #" + std::to_string(discovery.event);
+            break;
+        case Discovery::HOLDS_OTHER_ACCUSED_CARDS:
+            text += "holds the other cards in accusation #" + std::to_string(discovery.event);
+            break;
+        case Discovery::DID_NOT_SHOW:
+            text += "did not show a card in suggestion #" + std::to_string(discovery.event);
+            break;
+        case Discovery::ALL_CARDS_SHOWN:
+            text += "all three cards were shown by other players in suggestion #" + std::to_string(discovery.event);
+            break;
+        case Discovery::SHOWED_ONLY_POSSIBLE_CARD:
+            text += "showed a card in suggestion #" + std::to_string(discovery.event) + ", and does not hold the others";
+            break;
+        case Discovery::ANSWER_HOLDS_ANOTHER_OF_TYPE:
+            text += "ANSWER can only hold one " + type.id;
+            break;
+        case Discovery::ONLY_CARD_OF_TYPE_ANSWER_CAN_HOLD:
+            text += "Only " + type.id + " that ANSWER can hold";
+            break;
+        case Discovery::NOBODY_ELSE_HOLDS:
+            text += "nobody else holds it";
+            break;
+        case Discovery::NO_CONSISTENT_DEAL:
+            text += "no deal consistent with what is known";
+            break;
     }
+    return text;
 }
 
-bool Solver::cardIsType(Id const & c, Id const & type) const
+std::vector<std::string> Solver::discoveries() const
 {
-    return cards_.find(c)->second.info.type == type;
+    std::vector<std::string> text;
+    text.reserve(discoveriesLog_.size());
+    for (auto const & d : discoveriesLog_)
+    {
+        text.push_back(describe(d));
+    }
+    return text;
 }
 
-void Solver::addDiscovery(Id const & playerId, Id const & cardId, bool holds, std::string const & reason /*= std::string()*/)
+void Solver::addDiscovery(int player, int card, bool holds, Discovery::Reason reason, int event /*= -1*/)
 {
-    auto fact = std::make_pair(playerId, cardId);
-    auto f    = facts_.find(fact);
-    if (f == facts_.end())
+    // A fact is logged only the first time it is discovered
+    int    cell = player * (int)cards_.size() + card;
+    Fact & fact = facts_[cell];
+    if (fact == UNKNOWN)
     {
-        facts_[fact] = holds;
-        if (!reason.empty())
-        {
-            CardInfo const & cardInfo  = cards_[cardId].info;
-            TypeInfo const & typeinfo  = types_[cardInfo.type];
-            std::string      discovery = playerId + (holds ? " holds " : " does not hold ") +
-                                         typeinfo.article + cardInfo.name +
-                                         ": " + reason;
-            discoveriesLog_.push_back(discovery);
-        }
+        fact = holds ? HOLDS : DOES_NOT_HOLD;
+        changes_.push_back({ Change::FACT, 0, 0, 0, cell });
+        ++statistics_.deductions[reason];
+        if (reason != Discovery::UNLOGGED)
+            discoveriesLog_.push_back({ (uint8_t)player, (uint8_t)card, holds, (uint8_t)reason, event });
     }
     else
     {
-        assert(f->second == holds);
+        assert(fact == (holds ? HOLDS : DOES_NOT_HOLD));
     }
 }
 
-void Solver::addDiscoveries(Id const & playerId, IdList const & cards, bool holds, std::string reason)
+void Solver::addDiscoveries(int player, std::vector<int> const & cards, bool holds, Discovery::Reason reason, int event)
 {
-    for (auto const & c : cards)
+    for (auto c : cards)
     {
-        addDiscovery(playerId, c, holds, reason);
+        addDiscovery(player, c, holds, reason, event);
     }
 }
 
 void Solver::addCardHoldersToDiscoveries()
 {
-    for (auto & c : cards_)
+    // Only the cards whose holders have changed since the last check need to be checked again
+    forEachBit(dirtyCards_, [&] (int c) {
+        Mask holders = cards_[c].possible;
+        if (countBits(holders) == 1)
+            addDiscovery(lowestBit(holders), c, true, Discovery::NOBODY_ELSE_HOLDS);
+    });
+    dirtyCards_ = 0;
+}
+
+Solver::Statistics::Statistics()
+    : events()
+    , deductions()
+    , passes(0)
+    , showersExamined(0)
+    , accusationsExamined(0)
+{
+}
+
+void Solver::Statistics::record(Event event, uint64_t ns)
+{
+    EventTimes & e      = events[event];
+    int          bucket = (ns == 0) ? 0 : std::min(highestBit(ns) + 1, NUMBER_OF_BUCKETS - 1);
+    ++e.count;
+    e.totalNs += ns;
+    ++e.histogram[bucket];
+}
+
+void Solver::Statistics::add(Statistics const & other)
+{
+    for (int i = 0; i < NUMBER_OF_EVENTS; ++i)
+    {
+        events[i].count += other.events[i].count;
+        events[i].totalNs += other.events[i].totalNs;
+        for (int b = 0; b < NUMBER_OF_BUCKETS; ++b)
+        {
+            events[i].histogram[b] += other.events[i].histogram[b];
+        }
+    }
+    for (int r = 0; r < NUMBER_OF_REASONS; ++r)
+    {
+        deductions[r] += other.deductions[r];
+    }
+    passes += other.passes;
+    showersExamined += other.showersExamined;
+    accusationsExamined += other.accusationsExamined;
+}
+
+// The histograms list only the buckets that are not empty, each with the upper bound of its latencies
+json Solver::Statistics::toJson() const
+{
+    json j;
+    for (int i = 0; i < NUMBER_OF_EVENTS; ++i)
+    {
+        EventTimes const & e = events[i];
+        json               histogram = json::array();
+        for (int b = 0; b < NUMBER_OF_BUCKETS; ++b)
+        {
+            if (e.histogram[b] > 0)
+                histogram.push_back({ { "belowNs", uint64_t(1) << b }, { "count", e.histogram[b] } });
+        }
+        j["events"][EVENT_NAMES[i]] = {
+            { "count", e.count },
+            { "totalNs", e.totalNs },
+            { "meanNs", (e.count > 0) ? (double)e.totalNs / (double)e.count : 0.0 },
+            { "histogram", histogram }
+        };
+    }
+    for (int r = 0; r < NUMBER_OF_REASONS; ++r)
     {
-        IdList const & holders = c.second.possible;
-        if (holders.size() == 1)
-            addDiscovery(holders[0], c.first, true, "nobody else holds it");
+        j["deductions"][REASON_NAMES[r]] = deductions[r];
     }
+    j["passes"]              = passes;
+    j["showersExamined"]     = showersExamined;
+    j["accusationsExamined"] = accusationsExamined;
+    return j;
 }
 
-void Solver::Card::remove(Id const & playerId)
+void Solver::Card::remove(int player)
 {
-    possible.erase(std::remove(possible.begin(), possible.end(), playerId), possible.end());
+    possible &= ~bit(player);
 }
 
-bool Solver::Card::mightBeHeldBy(Id const & playerId) const
+bool Solver::Card::mightBeHeldBy(int player) const
 {
-    return std::find(possible.begin(), possible.end(), playerId) != possible.end();
+    return (possible & bit(player)) != 0;
 }
 
-bool Solver::Card::isHeldBy(Id const & playerId) const
+bool Solver::Card::isHeldBy(int player) const
 {
-    return possible.size() == 1 && possible[0] == playerId;
+    return possible == bit(player);
 }
 
-json Solver::Card::toJson() const
+json Solver::Card::toJson(Solver const & solver) const
 {
     json j;
-    j["possible"] = possible;
+    j["possible"] = solver.playerIds(possible);
     return j;
 }
 
-void Solver::Player::remove(Id const & cardId)
+void Solver::Player::remove(int card)
 {
-    possible.erase(std::remove(possible.begin(), possible.end(), cardId), possible.end());
+    possible &= ~bit(card);
 }
 
-bool Solver::Player::mightHold(Id const & cardId) const
+bool Solver::Player::mightHold(int card) const
 {
-    return std::find(possible.begin(), possible.end(), cardId) != possible.end();
+    return (possible & bit(card)) != 0;
 }
 
-json Solver::Player::toJson() const
+json Solver::Player::toJson(Solver const & solver) const
 {
     json j;
-    j["possible"] = possible;
+    j["possible"] = solver.cardIds(possible);
     return j;
 }
 
-json Solver::Suggestion::toJson() const
+json Solver::Suggestion::toJson(Solver const & solver) const
 {
     json j;
-    j["player"] = player;
-    j["cards"]  = cards;
-    j["showed"] = showed;
+    j["player"] = solver.deck_->players[player];
+    j["cards"]  = solver.cardIds(cardMask);
+    IdList showedIds;
+    for (auto p : showed)
+    {
+        showedIds.push_back(solver.deck_->players[p]);
+    }
+    j["showed"] = showedIds;
     return j;
 }
 
-nlohmann::json Solver::Accusation::toJson() const
+nlohmann::json Solver::Accusation::toJson(Solver const & solver) const
 {
     json j;
-    j["player"]  = player;
-    j["cards"]   = cards;
+    j["player"]  = solver.deck_->players[player];
+    j["cards"]   = solver.cardIds(cardMask);
     j["correct"] = correct;
     return j;
 }
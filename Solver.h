@@ -2,11 +2,22 @@
 #if !defined(SOLVER_H)
 #define SOLVER_H 1
 
+#include "Constraints.h"
+#include "DealSampler.h"
+#include "SharedList.h"
+#include "SymbolTable.h"
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <nlohmann/json_fwd.hpp>
+#include <random>
 #include <string>
+#include <string_view>
 #include <vector>
 
+class ClauseEngine;
+
 class Solver
 {
 public:
@@ -30,17 +41,171 @@ public:
     };
     using CardInfoList = std::map<std::string, CardInfo>;   //!< List of card info by card ID
 
+    using ProbabilityTable = std::map<Id, std::map<Id, double>>;    //!< Probabilities by player ID and card ID
+
+    //! Options for computing probabilities
+    struct ProbabilityOptions
+    {
+        //! How probabilities are computed
+        enum Method
+        {
+            AUTOMATIC,          //!< Counted exactly, unless that would be too expensive
+            EXACT,              //!< Counted exactly
+            SAMPLED             //!< Estimated by sampling
+        };
+
+        Method method;                  //!< How probabilities are computed
+        DealSampler::Options sampling;  //!< Options used if the probabilities are estimated by sampling
+
+        ProbabilityOptions() : method(AUTOMATIC) {}
+    };
+
+    //! Options for advising which suggestion to make
+    struct AdviceOptions
+    {
+        int count;              //!< Most suggestions to return
+        int samples;            //!< Number of deals sampled to estimate the chance of each response
+        int threads;            //!< Number of worker threads (0 means one per hardware thread)
+        uint64_t seed;          //!< Seed for the random number generators
+
+        AdviceOptions() : count(5), samples(1000), threads(0), seed(0) {}
+    };
+
+    //! A suggestion and how much it is expected to reveal about the answer
+    struct Advice
+    {
+        IdList cards;           //!< Cards in the suggestion, one of each type
+        double gain;            //!< Expected reduction in the uncertainty of the answer, in bits
+    };
+    using AdviceList = std::vector<Advice>;
+
+    //! A fact discovered by the solver. It is stored compactly and converted to text only when needed (see describe()).
+    struct Discovery
+    {
+        //! Why the fact was discovered
+        enum Reason
+        {
+            UNLOGGED,                           //!< Not logged (deduced in the course of other deductions)
+            HAND,                               //!< The player's hand is known
+            REVEALED,                           //!< The card was shown
+            MADE_ACCUSATION,                    //!< The player made accusation #event
+            HOLDS_OTHER_ACCUSED_CARDS,          //!< The answer holds the other cards in incorrect accusation #event
+            DID_NOT_SHOW,                       //!< The player did not show a card in suggestion #event
+            ALL_CARDS_SHOWN,                    //!< All the cards were shown by other players in suggestion #event
+            SHOWED_ONLY_POSSIBLE_CARD,          //!< The player showed a card in suggestion #event and doesn't hold the others
+            ANSWER_HOLDS_ANOTHER_OF_TYPE,       //!< The answer holds another card of the same type
+            ONLY_CARD_OF_TYPE_ANSWER_CAN_HOLD,  //!< The only card of its type that the answer can hold
+            NOBODY_ELSE_HOLDS,                  //!< Nobody else can hold the card
+            NO_CONSISTENT_DEAL                  //!< No deal consistent with everything known (found by full inference)
+        };
+
+        uint8_t player;         //!< Player index (players are indexed in order of ID, including the answer)
+        uint8_t card;           //!< Card index (cards are indexed in order of ID)
+        bool holds;             //!< True if the player holds the card, false if not
+        uint8_t reason;         //!< Why the fact was discovered (a Reason)
+        int event;              //!< ID of the suggestion or accusation the fact was discovered from, or -1
+    };
+    using DiscoveryList = std::vector<Discovery>;
+
+    //! Performance counters. Each solver has its own, so counting needs no synchronization. They can be combined with
+    //! add() once the solvers are done.
+    struct Statistics
+    {
+        //! Kinds of events
+        enum Event
+        {
+            HAND_EVENT,
+            SHOW_EVENT,
+            SUGGEST_EVENT,
+            ACCUSE_EVENT,
+            NUMBER_OF_EVENTS
+        };
+
+        static int const NUMBER_OF_REASONS = Discovery::NO_CONSISTENT_DEAL + 1;
+        static int const NUMBER_OF_BUCKETS = 40;   //!< Number of buckets in a latency histogram
+
+        //! Time spent on one kind of event
+        struct EventTimes
+        {
+            uint64_t count;                         //!< Number of events
+            uint64_t totalNs;                       //!< Total time, in nanoseconds
+            uint64_t histogram[NUMBER_OF_BUCKETS];  //!< Events by latency. Bucket i counts latencies of less than 2^i ns
+                                                    //!< and at least 2^(i-1) ns (the last one also counts longer ones).
+        };
+
+        EventTimes events[NUMBER_OF_EVENTS];        //!< Time spent by kind of event
+        uint64_t deductions[NUMBER_OF_REASONS];     //!< Facts deduced, by reason (see Discovery::Reason)
+        uint64_t passes;                            //!< Propagation passes made after the events
+        uint64_t showersExamined;                   //!< Players that showed a card re-examined during the passes
+        uint64_t accusationsExamined;               //!< Accusations re-examined during the passes
+
+        Statistics();
+
+        //! Records the latency of an event
+        void record(Event event, uint64_t ns);
+
+        //! Adds another solver's counters to these
+        void add(Statistics const & other);
+
+        //! Returns the counters as a json object
+        nlohmann::json toJson() const;
+    };
+
     //! Information about the rules
     struct Rules
     {
         Id id;                  //!< Id of the rules used, valid values are currently "master" and "classic"
         TypeInfoList types;     //!< Types by ID
         CardInfoList cards;     //!< Cards by ID
+        std::shared_ptr<SymbolTable const> typeTable;   //!< Type IDs in order (optional, built by the solver if missing)
+        std::shared_ptr<SymbolTable const> cardTable;   //!< Card IDs in order (optional, built by the solver if missing)
     };
 
-    // Constructor
+    //! An event given to applyBatch(), with its players and cards given by index (see playerIndex() and cardIndex())
+    struct BatchEvent
+    {
+        //! The kind of event
+        enum Kind
+        {
+            HAND,                   //!< The player's hand
+            SHOW,                   //!< The player showed a card (cards holds the card)
+            SUGGEST,                //!< The player made a suggestion
+            ACCUSE                  //!< The player made an accusation
+        };
+
+        Kind kind;
+        int player;                 //!< Player the event is about
+        std::vector<int> cards;     //!< Cards in the hand, suggestion, or accusation, or the card shown
+        std::vector<int> showed;    //!< Players that responded to a suggestion
+        bool correct;               //!< True if an accusation is correct
+        int id;                     //!< ID of the suggestion or accusation
+    };
+
+    //! Builds the rules' symbol tables of type IDs and card IDs. Building them once, when the rules are loaded (see
+    //! Configuration), saves each solver from building its own.
+    static void buildTables(Rules & rules);
+
+    // Constructor. Throws std::domain_error if there are more than MAX_CARDS cards or MAX_PLAYERS - 1 players.
     Solver(Rules const & rules, IdList const & players);
 
+    //! Returns a copy of the solver that can be given events without affecting this one, for exploring what would be
+    //! learned from hypothetical events. A copy shares the players, cards and types, the suggestions and accusations
+    //! (see SharedList), and the clause engine until either of them changes it. Everything else is copied: what is
+    //! known about each player and card, the facts, the showers, the changes recorded for undoing events, the latest
+    //! discoveries and the statistics. So a copy takes several allocations and time in proportion to the number of
+    //! events so far, though far less than applying the events again. The copy can undo the events before the fork as
+    //! well.
+    Solver fork() const { return *this; }
+
+    //! Turns full inference on or off, starting with the next event. The rules miss some facts that follow only from
+    //! several things known together, such as two suggestions and the number of cards a player holds. With full
+    //! inference, once the rules have made their deductions from an event, a clause engine (see ClauseEngine) finds every
+    //! fact that follows from everything known. It costs much more than the rules, but little enough for live play.
+    void setFullInference(bool enabled);
+
+    //! Returns true if full inference is on
+    bool fullInference() const { return fullInference_; }
+
     //! Processes a player's hand
     void hand(Id const & playerId, IdList const & cardIds);
 
@@ -53,17 +218,145 @@ public:
     //! Processes the result of an accusation
     void accuse(Id const & playerId, IdList const & cardIds, bool outcome, int id);
 
+    //! Processes a player's hand, given by index (see playerIndex() and cardIndex())
+    void hand(int player, std::vector<int> const & cards);
+
+    //! Processes a card being revealed by a player, given by index
+    void show(int player, int card);
+
+    //! Processes the result of a suggestion, given by index
+    void suggest(int player, std::vector<int> const & cards, std::vector<int> const & showed, int id);
+
+    //! Processes the result of an accusation, given by index
+    void accuse(int player, std::vector<int> const & cards, bool outcome, int id);
+
+    //! Processes a batch of events, such as the events of a finished game, when only what is known after the last one
+    //! matters. Returns the index in the batch of the event that each of the discoveries (see latestDiscoveries()) came
+    //! from, or -1 for a discovery that follows only from several events together.
+    //!
+    //! Each event is recorded in turn with the deductions it allows directly. The deductions that follow from what is
+    //! known together (re-examining the earlier suggestions and accusations, and full inference) are made once, at the
+    //! end, instead of after every event. Afterwards, the solver knows what it would have known if the events had been
+    //! processed one at a time. The events can still be undone one at a time. Undoing the last event of a batch settles
+    //! the event before it, which then costs as much as all the deductions that were saved.
+    std::vector<int> applyBatch(std::vector<BatchEvent> const & events);
+
+    //! Undoes the latest events, restoring the state from before them. Every change made by an event is recorded, so
+    //! undoing it takes time proportional to what it changed. Returns the number of events undone, which is less than
+    //! the number requested if there are fewer events.
+    int undo(int count = 1);
+
+    //! Returns the number of events processed (and not undone)
+    int events() const { return (int)marks_.size(); }
+
+    //! Returns the number of suggestions processed (and not undone)
+    int suggestionCount() const { return (int)suggestions_.size(); }
+
+    //! Returns the number of accusations processed (and not undone)
+    int accusationCount() const { return (int)accusations_.size(); }
+
     //! Returns a list of cards that might be held by the player
     IdList mightBeHeldBy(Id const & playerId) const;
 
     //! Returns a list of players that might hold the card
     IdList mightHold(Id const & cardId) const;
 
+    //! Returns the indexes of the cards that might be held by the player, given by index
+    std::vector<int> mightBeHeldBy(int player) const;
+
+    //! Returns the indexes of the players that might hold the card, given by index
+    std::vector<int> mightHold(int card) const;
+
+    //! Returns the probability of each player (including the answer) holding each card
+    //!
+    //! All deals consistent with everything known so far, including the number of cards each player was dealt, are
+    //! considered equally likely. If no deal is consistent, all probabilities are 0.
+    ProbabilityTable probabilities(ProbabilityOptions const & options = ProbabilityOptions()) const;
+
+    //! Returns every combination of one card of each type that is the answer in at least one deal consistent with
+    //! everything known so far, with the cards in type order.
+    //!
+    //! This can be fewer than the combinations of the cards that the answer might hold. Each combination is tested by a
+    //! satisfiability search (see ClauseEngine), and the tests are spread over a number of threads (0 means one per
+    //! hardware thread). The first consistent deal found shows that its answer is one of them without a test of its own,
+    //! so the search ends as soon as every other combination has been ruled out.
+    std::vector<IdList> viableAnswers(int threads = 0) const;
+
+    //! Returns the suggestions that the player could make next that are expected to reveal the most about the answer, best
+    //! first.
+    //!
+    //! Every combination of one card of each type is considered. The uncertainty of the answer is the number of bits
+    //! needed to identify it among the cards it might hold, and a suggestion's score is the expected reduction in the
+    //! uncertainty after the deductions made from the response. The chance of each response (who shows a card and which
+    //! card the player sees) is estimated by simulating the suggestion on deals sampled from those consistent with what
+    //! is known so far. The other players respond in the order they were given to the constructor.
+    AdviceList advise(Id const & playerId, AdviceOptions const & options = AdviceOptions()) const;
+
+    //! Returns the suggestions that a player, given by index, could make next (see above)
+    AdviceList advise(int player, AdviceOptions const & options = AdviceOptions()) const;
+
     //! Stores the state of the solver in a json object
     nlohmann::json toJson() const;
 
-    //! Returns latest discoveries
-    std::vector<std::string> discoveries() const { return discoveriesLog_; }
+    //! Returns a snapshot of the complete state of the solver in a compact binary form, which restore() turns back into a
+    //! solver. If history is false, what is needed to undo the events is left out. That makes the snapshot several times
+    //! smaller, but the restored solver cannot undo the events before the snapshot.
+    std::string snapshot(bool history = true) const;
+
+    //! Restores a solver from a snapshot made with the same rules and deck. The snapshot is read directly from memory, so
+    //! it can be a memory-mapped file. Throws std::domain_error if the snapshot is not valid or does not match the rules.
+    static Solver restore(Rules const & rules, void const * data, size_t size);
+
+    //! Returns the discoveries made by the latest event, as text
+    std::vector<std::string> discoveries() const;
+
+    //! Returns the discoveries made by the latest event. The list is valid until the next event.
+    DiscoveryList const & latestDiscoveries() const { return discoveriesLog_; }
+
+    //! Returns a discovery as text
+    std::string describe(Discovery const & discovery) const;
+
+    //! Returns the performance counters accumulated since the solver was constructed
+    Statistics const & statistics() const { return statistics_; }
+
+    //! Returns the number of players, including the answer
+    int playerCount() const { return (int)deck_->players.size(); }
+
+    //! Returns the number of cards
+    int cardCount() const { return (int)deck_->cards.size(); }
+
+    //! Returns the number of card types
+    int typeCount() const { return (int)deck_->types.size(); }
+
+    //! Returns the index of the answer
+    int answerIndex() const { return answer_; }
+
+    //! Returns the index of a valid player ID. Players are indexed in order of ID, including the answer.
+    int playerIndex(Id const & playerId) const;
+
+    //! Returns the index of a valid card ID. Cards are indexed in order of ID.
+    int cardIndex(Id const & cardId) const;
+
+    //! Returns the index of a valid type ID. Types are indexed in order of ID.
+    int typeIndex(Id const & typeId) const;
+
+    //! Returns the index of a player that takes part in events (not the answer), or -1 if the ID is not valid
+    int findPlayer(std::string_view playerId) const;
+
+    //! Returns the index of a card, or -1 if the ID is not valid
+    int findCard(std::string_view cardId) const { return deck_->cardTable->find(cardId); }
+
+    //! Returns the ID of a player by index
+    Id const & playerId(int player) const { return deck_->players[player]; }
+
+    //! Returns the ID of a card by index
+    Id const & cardId(int card) const { return deck_->cards[card].id; }
+
+    //! Returns the ID of a card type by index
+    Id const & typeId(int type) const { return deck_->types[type].id; }
+
+    //! Returns the index of a card's type
+    int cardType(int card) const { return deck_->cards[card].type; }
 
     //! Validates a list of player IDs
     bool playersAreValid(IdList const & playerIds) const;
@@ -82,85 +375,218 @@ public:
 
     static char const * const ANSWER_PLAYER_ID;   //!< Player ID of the answer
 
+    static int const MAX_CARDS   = 64;              //!< Maximum number of cards in the deck
+    static int const MAX_PLAYERS = 64;              //!< Maximum number of players, including the answer
+
 private:
+    using Mask = uint64_t;  // One bit per card index (player rows) or per player index (card columns)
+
+    // What is known about a player
     struct Player
     {
-        IdList possible;         // List of IDs of cards that the player might be holding
+        Mask possible;          // Cards that the player might be holding
+        int minCards;           // Fewest cards the player can be holding
+        int maxCards;           // Most cards the player can be holding
 
-        void           remove(Id const & cardId);
-        bool           mightHold(Id const & cardId) const;
-        nlohmann::json toJson() const;
+        void           remove(int card);
+        bool           mightHold(int card) const;
+        nlohmann::json toJson(Solver const & solver) const;
     };
 
+    // What is known about a card
     struct Card
     {
-        IdList possible;         // List of IDs of players that might be holding this card
-        CardInfo info;
+        Mask possible;          // Players that might be holding this card
 
-        void           remove(Id const & playerId);
-        bool           mightBeHeldBy(Id const & playerId) const;
-        bool           isHeldBy(Id const & playerId) const;
-        nlohmann::json toJson() const;
+        void           remove(int player);
+        bool           mightBeHeldBy(int player) const;
+        bool           isHeldBy(int player) const;
+        nlohmann::json toJson(Solver const & solver) const;
+    };
+
+    struct Type
+    {
+        Id id;
+        TypeInfo info;
+        Mask cards;             // Cards of this type
+    };
+
+    // The players, cards and types, which never change. A solver's copies share them.
+    struct Deck
+    {
+        struct CardDefinition
+        {
+            Id id;
+            CardInfo info;
+            int type;               // Index of the card's type
+        };
+
+        uint32_t hash;                      // Identifies the rules and the deck in snapshots
+        IdList players;                     // All the players (including the answer) in order of ID
+        std::vector<int> turnOrder;         // Players (not including the answer) in the order given to the constructor
+        std::vector<CardDefinition> cards;  // All the cards in order of ID
+        std::vector<Type> types;            // All the card types in order of ID
+        SymbolTable playerTable;            // Player IDs (including the answer) in order of ID
+        std::shared_ptr<SymbolTable const> cardTable;   // Card IDs in order of ID (shared with the rules)
+        std::shared_ptr<SymbolTable const> typeTable;   // Type IDs in order of ID (shared with the rules)
     };
 
     struct Suggestion
     {
         int id;
-        Id player;
-        IdList cards;
-        IdList showed;         // Value depends on the rules
-        nlohmann::json toJson() const;
+        int player;
+        std::vector<int> cards; // In the order given
+        Mask cardMask;
+        std::vector<int> showed; // Value depends on the rules
+        Mask showedMask;
+        Mask showers;           // Players that showed a card (only the last player listed, under classic rules)
+        int firstShower;        // Index of the first of the showers in the shower arrays (they are in order of player)
+        nlohmann::json toJson(Solver const & solver) const;
     };
 
     struct Accusation
     {
         int id;
-        Id player;
-        IdList cards;
+        int player;
+        std::vector<int> cards; // In the order given
+        Mask cardMask;
         bool correct;
-        nlohmann::json toJson() const;
+        nlohmann::json toJson(Solver const & solver) const;
     };
 
-    using Fact = std::pair<std::string, Id>;
+    //! What is known about whether a player holds a card
+    enum Fact : uint8_t
+    {
+        UNKNOWN,
+        HOLDS,
+        DOES_NOT_HOLD
+    };
 
-    using PlayerList     = std::map<Id, Player>;
-    using CardList       = std::map<Id, Card>;
-    using SuggestionList = std::vector<Suggestion>;
-    using AccusationList = std::vector<Accusation>;
-    using FactList       = std::map<Fact, bool>;
+    // A change made by an event, recorded so that it can be undone
+    struct Change
+    {
+        enum Kind : uint8_t
+        {
+            CELL,               // The player was found to not hold the card
+            FACT,               // The fact in cell index was discovered
+            HAND_SIZE,          // The player's hand size was set (index and value are the old fewest and most cards)
+            SHOWER_CLOSED,      // Shower index was found to hold one of the cards
+            ACCUSATION_CLOSED   // Nothing more can be deduced from accusation index
+        };
+
+        Kind kind;
+        uint8_t player;
+        uint8_t card;
+        uint8_t value;
+        int index;
+    };
 
-    bool mustHoldOne(Id const & playerId, IdList const & cardIds, Id & held);
-    bool mustNotHoldOne(Id const & playerId, IdList const & cardIds, Id & notHeld);
+    // The sizes of everything an event may append to, recorded before the event
+    struct Mark
+    {
+        size_t changes;
+        size_t suggestions;
+        size_t showers;
+        size_t accusations;
+        bool settled;           // False if the deductions from the event were left to a later event in its batch
+    };
 
-    void deduce(Suggestion const & suggestion, bool & changed);
-    void deduce(Accusation const & accusation, bool & changed);
-    void deduce(Id const & playerId, IdList const & cardIds, bool & changed);
-    void deduce(Id const & playerId, Id const & cardId, bool & changed);
+    using PlayerList     = std::vector<Player>;
+    using CardList       = std::vector<Card>;
+    using SuggestionList = SharedList<Suggestion>;
+    using AccusationList = SharedList<Accusation>;
+    using FactTable      = std::vector<Fact>;
+    using ChangeList     = std::vector<Change>;
+    using MarkList       = std::vector<Mark>;
+
+    bool mustHoldOne(int player, Mask cards, int & held) const;
+    bool mustNotHoldOne(int player, Mask cards, int & notHeld) const;
+
+    void deduce(int player, Mask cards, bool & changed);
+    void deduce(int player, int card, bool & changed);
     void deduceWithClassicRules(Suggestion const & suggestion, bool & changed);
     void deduceWithMasterRules(Suggestion const & suggestion, bool & changed);
+    void deduceFromShower(Suggestion const & suggestion, int player, bool & changed);
+    void deduceFromAccusation(int accusation, bool & changed);
+    void deduceFromIncorrectAccusation(int accusation, bool & changed);
+    void inferRemainingFacts(bool & changed);
+
+    int  nextChangedShower(int start) const;
+    void addSuggestion(Suggestion const & suggestion);
+    void addAccusation(Accusation const & accusation);
+    void beginEvent();
+    void undoLatestEvent();
+    void settleLatestEvent();
+    void recordHand(int player, std::vector<int> const & cards, bool & changed);
+    void recordShow(int player, int card, bool & changed);
+    void recordSuggestion(int                      player,
+                          std::vector<int> const & cards,
+                          std::vector<int> const & showed,
+                          int                      id,
+                          bool &                   changed);
+    void recordAccusation(int player, std::vector<int> const & cards, bool outcome, int id, bool & changed);
+    void cellChanged(int player, int card);
 
     bool makeOtherDeductions(bool changed);
     void checkThatAnswerHoldsExactlyOneOfEach(bool & changed);
 
-    void associatePlayerWithCard(Id const & playerId, Id const & cardId, bool & changed);
-    void disassociatePlayerWithCard(Id const & playerId, Id const & cardId, bool & changed);
-    void disassociatePlayerWithCards(Id const & playerId, IdList const & cardIds, bool & changed);
-    void disassociateOtherPlayersWithCard(Id const & playerId, Id const & cardId, bool & changed);
-
-    bool cardIsType(Id const & cardId, Id const & type) const;
+    void associatePlayerWithCard(int player, int card, bool & changed);
+    void disassociatePlayerWithCard(int player, int card, bool & changed);
+    void disassociatePlayerWithCards(int player, Mask cards, bool & changed);
+    void disassociateOtherPlayersWithCard(int player, int card, bool & changed);
+
+    Constraints constraints() const;
+    double answerUncertainty() const;
+    double expectedAnswerUncertainty(int                                   suggester,
+                                     std::vector<int> const &              responders,
+                                     std::vector<int> const &              cards,
+                                     std::vector<std::vector<int>> const & deals,
+                                     std::mt19937_64 &                     rng) const;
+
+    Mask heldBy(int player, Mask cards) const;
+    Mask toMask(std::vector<int> const & indexes) const;
+    std::vector<int> cardIndexes(IdList const & cardIds) const;
+    std::vector<int> playerIndexes(IdList const & playerIds) const;
+    IdList cardIds(Mask cards) const;
+    IdList playerIds(Mask players) const;
 
     void addCardHoldersToDiscoveries();
-    void addDiscovery(Id const & playerId, Id const & cardId, bool holds, std::string const & reason = std::string());
-    void addDiscoveries(Id const & playerId, IdList const & cards, bool holds, std::string reason);
+    void addDiscovery(int player, int card, bool holds, Discovery::Reason reason, int event = -1);
+    void addDiscoveries(int player, std::vector<int> const & cards, bool holds, Discovery::Reason reason, int event);
+
+    using SuggestionRule = void (Solver::*)(Suggestion const & suggestion, bool & changed);
 
-    std::string rulesId_;
-    PlayerList players_;            // List of all the players by ID
-    CardList cards_;                // List of all the cards by ID
-    TypeInfoList types_;            // List of all card types by ID
+    std::shared_ptr<Deck const> deck_; // Players, cards and types (shared by the copies)
+    bool master_;                   // True if Master Detective rules are used
+    SuggestionRule deduceFrom_;     // Makes the deductions from a suggestion under the rules used (chosen once)
+    int answer_;                    // Index of the answer
+    PlayerList players_;            // What is known about each player (including the answer) in order of ID
+    CardList cards_;                // What is known about each card in order of ID
     SuggestionList suggestions_;    // List of all suggestions
     AccusationList accusations_;    // List of all accusation
-    FactList facts_;
-    std::vector<std::string> discoveriesLog_;
+    FactTable facts_;               // Facts that have been discovered, by cell (player * #cards + card)
+    DiscoveryList discoveriesLog_;  // Discoveries made by the latest event
+    Statistics statistics_;         // Performance counters
+    bool fullInference_;            // True if the clause engine finds the facts that the rules miss
+    std::shared_ptr<ClauseEngine> engine_;  // Clause engine used for full inference (shared by copies until changed)
+
+    // Every player that showed a card in a suggestion is a shower, and the showers are stored as parallel arrays so that
+    // the ones to re-examine can be found by checking many at once. A shower needs to be re-examined when the cards it
+    // might have shown have changed since it was last examined. Once the card shown is known, its masks are cleared.
+    std::vector<int> showerPlayers_;        // Player that showed a card
+    std::vector<int> showerSuggestions_;    // Index of the suggestion
+    std::vector<Mask> showerCards_;         // Suggested cards, or 0 once the player is known to hold one of them
+    std::vector<Mask> showerSeen_;          // Suggested cards the player might have held when last examined
+
+    ChangeList changes_;                    // Changes made by the events, in order
+    MarkList marks_;                        // Where each event starts in the lists above, by event
+
+    Mask accusedCards_;                     // Cards in incorrect accusations
+    std::vector<Mask> activeAccusations_;   // Accusations from which more might be deduced
+    std::vector<Mask> dirtyAccusations_;    // Accusations whose cells have changed since they were last examined
+    Mask dirtyCards_;                       // Cards whose holders have changed since they were last checked
+    Mask answerTypes_;                      // Types in which the answer might now hold only one card, or holds a card
+    Mask answerHeld_;                       // Cards known to be held by the answer
 };
 
 #endif // !defined(SOLVER_H)
@@ -0,0 +1,106 @@
+#pragma once
+#if !defined(SPSCQUEUE_H)
+#define SPSCQUEUE_H 1
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! A bounded queue that passes items from one thread to another without locks.
+//!
+//! Exactly one thread may push items and exactly one thread may pop them. The items are kept in a ring buffer. Each side
+//! owns its own position and publishes it to the other side with release ordering, so an item is fully written before it
+//! can be popped. Each side also keeps its latest view of the other side's position, so that it reads the shared
+//! position only when the queue looks full (or empty). A push to a full queue or a pop from an empty one waits, yielding
+//! the thread, until the other side catches up.
+//!
+//! Items are swapped into and out of the buffer rather than copied, so the objects (and any memory they hold) circulate
+//! between the two sides instead of being made anew for each item.
+template <typename T>
+class SpscQueue
+{
+public:
+    //! Constructor. The capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity)
+        : head_(0)
+        , cachedTail_(0)
+        , tail_(0)
+        , cachedHead_(0)
+    {
+        assert(capacity > 0);
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        items_.resize(size);
+        mask_ = size - 1;
+    }
+
+    //! Adds an item if there is room, leaving an unused object in its place. Returns false (leaving the item alone) if
+    //! the queue is full. Producer only.
+    bool tryPush(T & item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_)
+                return false;
+        }
+        std::swap(items_[tail & mask_], item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Adds an item, waiting for room if the queue is full. Producer only.
+    void push(T & item)
+    {
+        while (!tryPush(item))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    //! Removes the oldest item if there is one, giving the object that was in the item's place to the queue. Returns
+    //! false if the queue is empty. Consumer only.
+    bool tryPop(T & item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+        std::swap(items_[head & mask_], item);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Removes the oldest item, waiting for one if the queue is empty. Consumer only.
+    void pop(T & item)
+    {
+        while (!tryPop(item))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<T> items_;
+    size_t mask_;                                   // Capacity - 1
+
+    // The consumer's side, on its own cache line
+    alignas(64) std::atomic<size_t> head_;          // Position of the next item to pop
+    size_t cachedTail_;                             // The consumer's latest view of tail_
+
+    // The producer's side, on its own cache line
+    alignas(64) std::atomic<size_t> tail_;          // Position of the next item to push
+    size_t cachedHead_;                             // The producer's latest view of head_
+};
+
+#endif // !defined(SPSCQUEUE_H)
@@ -0,0 +1,126 @@
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace
+{
+// Scrambles the bits of a hash (the finalizer of MurmurHash3)
+uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+} // anonymous namespace
+
+SymbolTable::SymbolTable(std::vector<std::string> const & names)
+    : names_(names)
+{
+    std::vector<std::string> sorted = names;
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+        throw std::domain_error("Duplicate name");
+    if (names_.empty())
+        return;
+
+    // About two names per bucket keeps the displacements few and quick to find
+    size_t                            n = names_.size();
+    std::vector<uint64_t>             hashes(n);
+    std::vector<std::vector<int32_t>> buckets((n + 1) / 2);
+    for (size_t i = 0; i < n; ++i)
+    {
+        hashes[i] = hash(names_[i]);
+        buckets[bucket(hashes[i], buckets.size())].push_back((int32_t)i);
+    }
+
+    // The largest buckets are the hardest to place, so they are placed first, while most slots are free
+    std::vector<int32_t> order(buckets.size());
+    for (size_t b = 0; b < buckets.size(); ++b)
+    {
+        order[b] = (int32_t)b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&] (int32_t a, int32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    displacements_.assign(buckets.size(), 0);
+    slots_.assign(n, -1);
+    std::vector<uint32_t> placed;
+    size_t                nextFree = 0;
+    for (int32_t b : order)
+    {
+        std::vector<int32_t> const & members = buckets[b];
+        if (members.empty())
+            break;
+
+        if (members.size() == 1)
+        {
+            while (slots_[nextFree] >= 0)
+            {
+                ++nextFree;
+            }
+            slots_[nextFree]  = members[0];
+            displacements_[b] = -1 - (int32_t)nextFree;
+            continue;
+        }
+
+        // Try displacements until every name in the bucket lands in a different free slot. The names are distinct, so
+        // their hashes almost certainly are, and a displacement is found after a few tries.
+        for (int32_t d = 0;; ++d)
+        {
+            assert(d < INT32_MAX);
+            placed.clear();
+            for (int32_t i : members)
+            {
+                uint32_t s = slot(hashes[i], d, n);
+                if (slots_[s] >= 0 || std::find(placed.begin(), placed.end(), s) != placed.end())
+                    break;
+                placed.push_back(s);
+            }
+            if (placed.size() == members.size())
+            {
+                for (size_t k = 0; k < members.size(); ++k)
+                {
+                    slots_[placed[k]] = members[k];
+                }
+                displacements_[b] = d;
+                break;
+            }
+        }
+    }
+}
+
+int SymbolTable::find(std::string_view name) const
+{
+    if (names_.empty())
+        return -1;
+    uint64_t h = hash(name);
+    int32_t  d = displacements_[bucket(h, displacements_.size())];
+    int32_t  i = slots_[(d < 0) ? -1 - d : slot(h, d, slots_.size())];
+    return (names_[i] == name) ? i : -1;
+}
+
+// FNV-1a, with the bits scrambled so that both halves of the hash are usable
+uint64_t SymbolTable::hash(std::string_view name)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : name)
+    {
+        h ^= (uint8_t)c;
+        h *= 0x100000001b3ULL;
+    }
+    return mix(h);
+}
+
+// Maps a hash and a displacement to a slot. The slot is taken from the high bits of a 32-bit product, which avoids a
+// division (as does bucket()).
+uint32_t SymbolTable::slot(uint64_t h, int32_t displacement, size_t slots)
+{
+    uint64_t x = (h ^ ((uint64_t)displacement * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL;
+    return (uint32_t)(((x >> 32) * slots) >> 32);
+}
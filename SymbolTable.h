@@ -0,0 +1,44 @@
+#pragma once
+#if !defined(SYMBOLTABLE_H)
+#define SYMBOLTABLE_H 1
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! An immutable table of distinct names (such as card, type, or player IDs), each identified by a small index.
+//!
+//! The names are placed with a minimal perfect hash, built once by the constructor, so finding a name takes one hash of
+//! the name and one comparison, however many names there are. The names are hashed into buckets, and each bucket is
+//! given a displacement that places all of its names in free slots (a bucket with a single name is simply given a free
+//! slot). The table has exactly one slot per name.
+class SymbolTable
+{
+public:
+    //! Constructor. The table is empty.
+    SymbolTable() = default;
+
+    //! Constructor. A name's index is its position in the list. The names must be distinct.
+    explicit SymbolTable(std::vector<std::string> const & names);
+
+    //! Returns the index of a name, or -1 if it is not in the table
+    int find(std::string_view name) const;
+
+    //! Returns the number of names
+    int size() const { return (int)names_.size(); }
+
+    //! Returns a name by index
+    std::string const & operator[](int index) const { return names_[index]; }
+
+private:
+    static uint64_t hash(std::string_view name);
+    static uint32_t bucket(uint64_t h, size_t buckets) { return (uint32_t)(((h >> 32) * buckets) >> 32); }
+    static uint32_t slot(uint64_t h, int32_t displacement, size_t slots);
+
+    std::vector<std::string> names_;
+    std::vector<int32_t>     displacements_;    // By bucket: a displacement, or -1 - the slot of a bucket's only name
+    std::vector<int32_t>     slots_;            // Index of the name in each slot
+};
+
+#endif // !defined(SYMBOLTABLE_H)
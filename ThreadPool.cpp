@@ -0,0 +1,127 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+thread_local ThreadPool const * t_pool   = nullptr;   // Pool that the current thread works for (if any)
+thread_local int                t_worker = -1;        // Index of the current thread in that pool
+} // anonymous namespace
+
+ThreadPool::ThreadPool(int threads)
+    : next_(0)
+    , queued_(0)
+    , pending_(0)
+    , stopping_(false)
+{
+    if (threads <= 0)
+        threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < threads; ++i)
+    {
+        queues_.emplace_back(new Queue);
+    }
+    for (int i = 0; i < threads; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for (auto & w : workers_)
+    {
+        w.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    int q = (t_pool == this) ? t_worker : (int)(next_++ % queues_.size());
+    ++pending_;
+    ++queued_;
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+
+    // The lock ensures that a worker that has just found nothing to do is waiting before it is notified
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    available_.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    assert(t_pool != this);    // A worker waiting for its own pool would wait forever
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::run(int worker)
+{
+    t_pool   = this;
+    t_worker = worker;
+
+    while (true)
+    {
+        Task task;
+        if (take(worker, task))
+        {
+            task();
+            if (--pending_ == 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                finished_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopping_)
+            break;
+
+        // A task may have been submitted since the queues were checked, in which case the queues are checked again
+        if (queued_ == 0)
+            available_.wait(lock);
+    }
+}
+
+// Takes the next task for the worker, from its own queue if possible, or else from another worker's queue
+bool ThreadPool::take(int worker, Task & task)
+{
+    {
+        Queue &                     own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+
+    int n = (int)queues_.size();
+    for (int i = 1; i < n; ++i)
+    {
+        Queue &                     victim = *queues_[(worker + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#if !defined(THREADPOOL_H)
+#define THREADPOOL_H 1
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A pool of worker threads that run tasks.
+//!
+//! Each worker has its own queue of tasks. A worker takes tasks from the back of its own queue, and when its queue is
+//! empty, it steals a task from the front of another worker's queue, so the workers stay busy even when the tasks take
+//! very different amounts of time. Tasks submitted by a worker go to its own queue, and the rest are spread evenly.
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    //! Constructor. If the number of threads is 0, there is one per hardware thread.
+    explicit ThreadPool(int threads = 0);
+
+    //! Destructor. Waits for all tasks to finish.
+    ~ThreadPool();
+
+    //! Returns the number of worker threads
+    int size() const { return (int)workers_.size(); }
+
+    //! Adds a task
+    void submit(Task task);
+
+    //! Waits until all submitted tasks have finished
+    void wait();
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int worker);
+    bool take(int worker, Task & task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;    // One per worker
+    std::vector<std::thread> workers_;
+    std::atomic<unsigned> next_;                    // Queue receiving the next task submitted from outside the pool
+    std::mutex mutex_;                              // Guards the condition variables and stopping_
+    std::condition_variable available_;             // Signaled when a task is submitted or the pool is stopping
+    std::condition_variable finished_;              // Signaled when the last pending task finishes
+    std::atomic<int> queued_;                       // Tasks submitted but not yet started
+    std::atomic<int> pending_;                      // Tasks submitted but not yet finished
+    bool stopping_;
+};
+
+#endif // !defined(THREADPOOL_H)
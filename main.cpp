@@ -1,146 +1,52 @@
-#include "Solver.h"
+#include "Configuration.h"
+#include "EventLog.h"
+#include "MappedFile.h"
+#include "Replay.h"
+#include "Server.h"
+#include "ThreadPool.h"
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-
-using json = nlohmann::json;
+#include <memory>
+#include <mutex>
+#include <sstream>
 
 namespace
 {
-bool loadConfiguration(char const * name);
-void listTypes(std::ostream & out, Solver::TypeInfoList const & types);
-void listCards(std::ostream &               out,
-               Solver::Id const &           typeId,
-               Solver::TypeInfoList const & typeInfo,
-               Solver::CardInfoList const & cards);
-
-Solver::TypeInfoList s_types =
-{
-    { "suspect",    { "Suspects", "",      ""     } },
-    { "weapon",     { "Weapons",  "with ", "the " } },
-    { "room",       { "Rooms",    "in ",   "the " } }
-};
-
-Solver::CardInfoList s_cards =
-{
-    { "mustard",      { "Colonel Mustard", "suspect" } },
-    { "white",        { "Mrs. White",      "suspect" } },
-    { "plum",         { "Professor Plum",  "suspect" } },
-    { "peacock",      { "Mrs. Peacock",    "suspect" } },
-    { "green",        { "Mr. Green",       "suspect" } },
-    { "scarlet",      { "Miss Scarlet",    "suspect" } },
-    { "revolver",     { "Revolver",        "weapon"  } },
-    { "knife",        { "Knife",           "weapon"  } },
-    { "rope",         { "Rope",            "weapon"  } },
-    { "pipe",         { "Lead pipe",       "weapon"  } },
-    { "wrench",       { "Wrench",          "weapon"  } },
-    { "candlestick",  { "Candlestick",     "weapon"  } },
-    { "dining",       { "Dining room",     "room"    } },
-    { "conservatory", { "Conservatory",    "room"    } },
-    { "kitchen",      { "Kitchen",         "room"    } },
-    { "study",        { "Study",           "room"    } },
-    { "library",      { "Library",         "room"    } },
-    { "billiard",     { "Billiard room",   "room"    } },
-    { "lounge",       { "Lounge",          "room"    } },
-    { "ballroom",     { "Ballroom",        "room"    } },
-    { "hall",         { "Hall",            "room"    } }
-};
-
-std::string             s_rules = "classic";
-std::vector<Solver::Id> s_players;
-
-void outputSuggestion(std::ostream &         out,
-                      int                    id,
-                      Solver::Id const &     player,
-                      Solver::IdList const & cards,
-                      Solver::IdList const & results)
-{
-    out << '(' << std::setw(2) << id << ") " << player << " suggested";
-
-    for (auto const & c : cards)
-    {
-        Solver::CardInfo const & cardInfo = s_cards[c];
-        out << " " << s_types[cardInfo.type].preposition << s_types[cardInfo.type].article << cardInfo.name;
-    }
-
-    out << " ==> ";
-    if (results.empty())
-    {
-        out << "nobody has them";
-    }
-    else
-    {
-        if (s_rules == "master")
-        {
-            out << results[0];
-            for (size_t i = 1; i < results.size(); ++i)
-            {
-                out << ", " << results[i];
-            }
-            out << " showed a card";
-        }
-        else
-        {
-            if (results.size() > 1)
-            {
-                out << results[0];
-                for (size_t i = 1; i < results.size()-1; ++i)
-                {
-                    out << ", " << results[i];
-                }
-                out << " had nothing, but ";
-            }
-            out << results.back() << " showed a card";
-        }
-    }
-    out << std::endl;
-}
-
-void outputShow(std::ostream & out, Solver::Id const & player, Solver::Id const & card)
-{
-    Solver::CardInfo const & cardInfo = s_cards[card];
-    out << "---- " << player << " showed " << s_types[cardInfo.type].article << s_cards[card].name << std::endl;
-}
-
-void outputHand(std::ostream & out, Solver::Id const & player, Solver::IdList const & cards)
-{
-    out << "**** " << player << " has this hand: ";
-    out << s_cards[cards[0]].name;
-    for (size_t i = 1; i < cards.size(); ++i)
-    {
-        out << ", " << s_cards[cards[i]].name;
-    }
-    out << std::endl;
-}
-
-void outputAccusation(std::ostream & out, int id, Solver::Id const & player, Solver::IdList const & cards, bool correct)
-{
-    out << '(' << std::setw(2) << id << ") " << player << " accused";
-
-    for (auto const & c : cards)
-    {
-        Solver::CardInfo const & cardInfo = s_cards[c];
-        out << " " << s_types[cardInfo.type].preposition << s_types[cardInfo.type].article << cardInfo.name;
-    }
-
-    out << " ==> " << (correct ? "correct" : "wrong");
-    out << std::endl;
-}
-
+int replayAll(Configuration const & configuration,
+              char const *          batchDirectoryName,
+              char const *          outputDirectoryName,
+              int                   threads,
+              bool                  convert,
+              ReplayOptions const & options);
+int serve(Configuration const & configuration, char const * socketName, int threads);
 } // anonymous namespace
 
 int main(int argc, char ** argv)
 {
-    char *         configurationFileName = nullptr;
-    char *         inputFileName         = nullptr;
-    char *         outputFileName        = nullptr;
-    std::ifstream  infilestream;
-    std::ofstream  outfilestream;
-    std::istream * in  = &std::cin;
-    std::ostream * out = &std::cout;
+    char *             configurationFileName = nullptr;
+    char *             inputFileName         = nullptr;
+    char *             outputFileName        = nullptr;
+    char *             batchDirectoryName    = nullptr;
+    char *             socketName            = nullptr;
+    int                threads               = 0;
+    bool               showStatistics        = false;
+    bool               convert               = false;
+    ReplayOptions      options;
+    Solver::Statistics statistics;
+    std::ifstream      infilestream;
+    std::ofstream      outfilestream;
+    std::istream *     in  = &std::cin;
+    std::ostream *     out = &std::cout;
 
     while (--argc > 0)
     {
@@ -149,14 +55,40 @@ int main(int argc, char ** argv)
         {
             switch ((*argv)[1])
             {
+                case 'b':
+                    if (--argc > 0)
+                        batchDirectoryName = *++argv;
+                    break;
                 case 'c':
                     if (--argc > 0)
                         configurationFileName = *++argv;
                     break;
+                case 'f':
+                    options.fullInference = true;
+                    break;
+                case 'j':
+                    if (--argc > 0)
+                        threads = atoi(*++argv);
+                    break;
                 case 'o':
                     if (--argc > 0)
                         outputFileName = *++argv;
                     break;
+                case 'p':
+                    options.showProbabilities = true;
+                    break;
+                case 's':
+                    if (--argc > 0)
+                        socketName = *++argv;
+                    break;
+                case '-':
+                    if (strcmp(*argv, "--stats") == 0)
+                        showStatistics = true;
+                    else if (strcmp(*argv, "--pipeline") == 0)
+                        options.pipelined = true;
+                    else if (strcmp(*argv, "--convert") == 0)
+                        convert = true;
+                    break;
             }
         }
         else
@@ -167,32 +99,57 @@ int main(int argc, char ** argv)
     }
 
     // Load configuration
+    Configuration configuration;
     if (configurationFileName)
     {
-        if (!loadConfiguration(configurationFileName))
+        if (!configuration.load(configurationFileName))
         {
-            std::cerr << "Cannot load the configuration from '" << inputFileName << "'" << std::endl;
+            std::cerr << "Cannot load the configuration from '" << configurationFileName << "'" << std::endl;
             exit(1);
         }
     }
 
+    if (showStatistics)
+        options.statistics = &statistics;
+
+    if (batchDirectoryName)
+    {
+        int result = replayAll(configuration, batchDirectoryName, outputFileName, threads, convert, options);
+        if (showStatistics)
+            std::cerr << statistics.toJson().dump(4) << std::endl;
+        return result;
+    }
+
+    if (socketName)
+        return serve(configuration, socketName, threads);
+
+    // An event log is replayed directly from memory
+    std::unique_ptr<MappedFile> log;
     if (inputFileName)
     {
-        infilestream.open(inputFileName);
-        if (infilestream.is_open())
+        auto file = std::make_unique<MappedFile>(inputFileName);
+        if (!convert && file->valid() && EventLog::matches(file->data(), file->size()))
         {
-            in = &infilestream;
+            log = std::move(file);
         }
         else
         {
-            std::cerr << "Cannot open '" << inputFileName << "' for reading." << std::endl;
-            exit(2);
+            infilestream.open(inputFileName);
+            if (infilestream.is_open())
+            {
+                in = &infilestream;
+            }
+            else
+            {
+                std::cerr << "Cannot open '" << inputFileName << "' for reading." << std::endl;
+                exit(2);
+            }
         }
     }
 
     if (outputFileName)
     {
-        outfilestream.open(outputFileName);
+        outfilestream.open(outputFileName, convert ? std::ios::out | std::ios::binary : std::ios::out);
         if (outfilestream.is_open())
         {
             out = &outfilestream;
@@ -204,212 +161,180 @@ int main(int argc, char ** argv)
         }
     }
 
-    *out << "Rules: " << s_rules << std::endl;
-    listTypes(*out, s_types);
-    for (auto const & t : s_types)
-    {
-        listCards(*out, t.first, s_types, s_cards);
-    }
-
-    *out << std::endl;
-
-    // Load player list
-    Solver::Id input;
-    std::getline(*in, input);
-    s_players = json::parse(input);
-
-    *out << "players = " << json(s_players).dump() << std::endl;
-    *out << std::endl;
-
-    int           suggestionId = 0;
-    int           accusationId = 0;
-    Solver::Rules rules        = { s_rules, s_types, s_cards };
-    Solver        solver(rules, s_players);
-    while (true)
+    try
     {
-        std::getline(*in, input);
-        if (in->eof())
-            break;
-        try
-        {
-            json event = json::parse(input);
-
-            if (event.find("show") != event.end())
-            {
-                auto       s      = event["show"];
-                Solver::Id player = s["player"];
-                if (!solver.playerIsValid(player))
-                    throw std::domain_error("Invalid player");
-                Solver::Id card = s["card"];
-                if (!solver.cardIsValid(card))
-                    throw std::domain_error("Invalid card");
-                outputShow(*out, player, card);
-                solver.show(player, card);
-            }
-            else if (event.find("suggest") != event.end())
-            {
-                auto       s      = event["suggest"];
-                Solver::Id player = s["player"];
-                if (!solver.playerIsValid(player))
-                    throw std::domain_error("Invalid player");
-                Solver::IdList cards = s["cards"];
-                if (!solver.cardsAreValid(cards))
-                    throw std::domain_error("Invalid cards");
-                Solver::IdList showed = s["showed"];
-                if (!solver.playersAreValid(showed))
-                    throw std::domain_error("Invalid players");
-                outputSuggestion(*out, suggestionId, player, cards, showed);
-                solver.suggest(player, cards, showed, suggestionId);
-                ++suggestionId;
-            }
-            else if (event.find("hand") != event.end())
-            {
-                auto           h      = event["hand"];
-                Solver::Id     player = h["player"];
-                Solver::IdList cards  = h["cards"];
-                if (!solver.playerIsValid(player))
-                    throw std::domain_error("Invalid player");
-                if (!solver.cardsAreValid(cards))
-                    throw std::domain_error("Invalid hand");
-                outputHand(*out, player, cards);
-                solver.hand(player, cards);
-            }
-            else if (event.find("accuse") != event.end())
-            {
-                auto       s = event["accuse"];
-                Solver::Id player = s["player"];
-                if (!solver.playerIsValid(player))
-                    throw std::domain_error("Invalid player");
-                Solver::IdList cards = s["cards"];
-                if (!solver.cardsAreValid(cards))
-                    throw std::domain_error("Invalid cards");
-                bool correct = s["correct"];
-                outputAccusation(*out, suggestionId, player, cards, correct);
-                solver.accuse(player, cards, correct, accusationId);
-                ++accusationId;
-            }
-            else
-            {
-                throw std::domain_error("Invalid event type");
-            }
-
-            {
-                std::vector<std::string> discoveries = solver.discoveries();
-                for (auto const & d : discoveries)
-                {
-                    *out << "     -> " << d << std::endl;
-                }
-            }
-
-//            *out << "state = " << solver.toJson().dump() << std::endl;
-            *out << "ANSWER: " << json(solver.mightBeHeldBy(Solver::ANSWER_PLAYER_ID)).dump() << std::endl;
-            *out << std::endl;
-        }
-        catch (std::exception e)
+        if (convert)
         {
-            std::cerr << e.what() << ": '" << input << "'" << std::endl;
+            EventLog::convert(configuration, *in, *out, std::cerr);
+            return 0;
         }
+        if (log)
+            replay(configuration, EventLog(log->data(), log->size()), *out, std::cerr, options);
+        else
+            replay(configuration, *in, *out, std::cerr, options);
     }
+    catch (std::exception const & e)
+    {
+        char const * action = convert ? "convert" : "replay";
+        if (inputFileName)
+            std::cerr << "Cannot " << action << " '" << inputFileName << "': " << e.what() << std::endl;
+        else
+            std::cerr << "Cannot " << action << " the input: " << e.what() << std::endl;
+        exit(5);
+    }
+    if (showStatistics)
+        std::cerr << statistics.toJson().dump(4) << std::endl;
     return 0;
 }
 
 namespace
 {
-//    {
-//        "types" : [
-//            { "id" : "suspect", "title" : "Suspects", "article" : "",     "preposition" : ""      },
-//            { "id" : "weapon",  "title" : "Weapons",  "article" : "the ", "preposition" : "with " },
-//            { "id" : "room",    "title" : "Rooms",    "article" : "the ",  preposition" : "in "   }
-//        ]
-// }
-//    {
-//        "cards" : [
-//            { "id" : "mustard", "name" : "Colonel Mustard", "type" : "suspect" },
-//            { "id" : "knife",   "name" : "Knife",           "type" : "weapon" },
-//            { "id" : "studio",  "name" : "Studio",          "type" : "room" }
-//        ]
-// }
-
-bool loadConfiguration(char const * name)
+// Replays every game (*.js, or an event log *.clog) in the batch directory on a pool of threads, writing the results of
+// each game to a file of the same name (with the extension .txt) in the output directory, or the batch directory if
+// there is no output directory. Every game has its own solver, and the configuration is shared by all of them. If
+// statistics are wanted, each game's are added to them when the game is done. If converting, each game (*.js) is
+// converted to an event log (*.clog) instead.
+int replayAll(Configuration const & configuration,
+              char const *          batchDirectoryName,
+              char const *          outputDirectoryName,
+              int                   threads,
+              bool                  convert,
+              ReplayOptions const & options)
 {
-    std::ifstream file(name);
-    if (!file.is_open())
-        return false;
+    namespace fs = std::filesystem;
 
-    try
+    fs::path        batchDirectory(batchDirectoryName);
+    fs::path        outputDirectory(outputDirectoryName ? outputDirectoryName : batchDirectoryName);
+    std::error_code error;
+
+    std::vector<fs::path> games;
+    for (auto const & entry : fs::directory_iterator(batchDirectory, error))
+    {
+        fs::path const & path = entry.path();
+        if (entry.is_regular_file() && (path.extension() == ".js" || (!convert && path.extension() == ".clog")))
+            games.push_back(path);
+    }
+    if (error)
     {
-        json j;
-        file >> j;
+        std::cerr << "Cannot read the directory '" << batchDirectoryName << "'." << std::endl;
+        exit(2);
+    }
+    std::sort(games.begin(), games.end());
 
-        s_rules = j["rules"];
-        s_types.clear();
-        s_cards.clear();
+    fs::create_directories(outputDirectory, error);
+    if (error)
+    {
+        std::cerr << "Cannot create the directory '" << outputDirectory.string() << "'." << std::endl;
+        exit(3);
+    }
 
-        json jtypes = j["types"];
-        for (auto const & a : jtypes)
-        {
-            if (a.find("id") == a.end() ||
-                a.find("title") == a.end() ||
-                a.find("article") == a.end() ||
-                a.find("preposition") == a.end())
-            {
-                throw std::domain_error("Invalid card type, missing information.");
-            }
+    // The games are already run in parallel, so the probabilities for each game are computed on a single thread
+    ReplayOptions gameOptions = options;
+    gameOptions.probability.sampling.threads = 1;
 
-            Solver::TypeInfo type = { a["title"], a["article"], a["preposition"] };
-            s_types[a["id"]] = type;
-        }
+    std::atomic<int> events(0);
+    std::atomic<int> failures(0);
+    std::mutex       errorsMutex;
+    std::mutex       statisticsMutex;
 
-        json jcards = j["cards"];
-        for (auto const & c : jcards)
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (auto const & game : games)
         {
-            if (c.find("id") == c.end() || c.find("name") == c.end() || c.find("type") == c.end())
-                throw std::domain_error("Invalid card configuration.");
+            pool.submit([&, game] () {
+                Solver::Statistics statistics;
+                ReplayOptions      replayOptions = gameOptions;
+                if (options.statistics)
+                    replayOptions.statistics = &statistics;
+
+                // An event log is mapped into memory and replayed from there
+                bool                        isLog = (game.extension() == ".clog");
+                std::ostringstream          errors;
+                std::ifstream               in;
+                std::unique_ptr<MappedFile> log;
+                fs::path output = outputDirectory / game.filename().replace_extension(convert ? ".clog" : ".txt");
+                std::ofstream out(output, convert ? std::ios::out | std::ios::binary : std::ios::out);
+                if (isLog)
+                    log = std::make_unique<MappedFile>(game.string().c_str());
+                else
+                    in.open(game);
+                if (isLog ? !log->valid() : !in.is_open())
+                {
+                    errors << "Cannot open '" << game.string() << "' for reading." << std::endl;
+                }
+                else if (!out.is_open())
+                {
+                    errors << "Cannot open the output for '" << game.string() << "' for writing." << std::endl;
+                }
+                else
+                {
+                    try
+                    {
+                        if (convert)
+                            events += EventLog::convert(configuration, in, out, errors);
+                        else if (isLog)
+                            events += replay(configuration, EventLog(log->data(), log->size()), out, errors, replayOptions);
+                        else
+                            events += replay(configuration, in, out, errors, replayOptions);
+                    }
+                    catch (std::exception const & e)
+                    {
+                        errors << e.what() << std::endl;
+                    }
+                }
+
+                if (options.statistics)
+                {
+                    std::lock_guard<std::mutex> lock(statisticsMutex);
+                    options.statistics->add(statistics);
+                }
 
-            Solver::CardInfo card = { c["name"], c["type"] };
-            s_cards[c["id"]] = card;
+                std::string report = errors.str();
+                if (!report.empty())
+                {
+                    ++failures;
+                    std::lock_guard<std::mutex> lock(errorsMutex);
+                    std::cerr << game.string() << ":" << std::endl << report;
+                }
+            });
         }
+        pool.wait();
     }
-    catch (std::exception e)
-    {
-        std::cout << "Failed to load configuration file: " << e.what() << std::endl;
-        return false;
-    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    return true;
+    std::cout << games.size() << " games (" << failures << " with errors), " << events << " events in " << seconds
+              << " s: " << games.size() / seconds << " games/s, " << events / seconds << " events/s" << std::endl;
+    return (failures > 0) ? 4 : 0;
 }
 
-void listCards(std::ostream &               out,
-               Solver::Id const &           typeId,
-               Solver::TypeInfoList const & typeInfo,
-               Solver::CardInfoList const & cards)
+#if !defined(_WIN32)
+Server * s_server = nullptr;
+
+void stopServer(int)
 {
-    out << typeInfo.find(typeId)->second.title << ": ";
-    bool first = true;
-    for (auto const & c : cards)
-    {
-        if (c.second.type == typeId)
-        {
-            if (!first)
-                out << ", ";
-            out << c.second.name;
-            first = false;
-        }
-    }
-    out << std::endl;
+    s_server->stop();
 }
+#endif
 
-void listTypes(std::ostream & out, Solver::TypeInfoList const & types)
+// Serves requests on a Unix domain socket until interrupted
+int serve(Configuration const & configuration, char const * socketName, int threads)
 {
-    out << "Types: ";
-    bool first = true;
-    for (auto const & t : types)
+#if !defined(_WIN32)
+    Server server(configuration, threads);
+    s_server = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGPIPE, SIG_IGN);
+    if (!server.run(socketName))
     {
-        if (!first)
-            out << ", ";
-        out << t.first;
-        first = false;
+        std::cerr << "Cannot listen on '" << socketName << "'." << std::endl;
+        return 3;
     }
-    out << std::endl;
+    return 0;
+#else
+    std::cerr << "Server mode is not supported on this platform." << std::endl;
+    return 3;
+#endif
 }
 } // anonymous namespace